@@ -4,47 +4,493 @@
 
 // ----------- CLOCK ----------------------------------------
 #define CLOCK_FREQUENCY  24000000       // (hertz)
-#define TIMER_COUNTER    480            // Number of clock cycles before every timer interrupt
-                                        // Here it also represents the baud rate of transmission (CLOCK_SPEED / TIMER_COUNTER)
+#define TIMER_COUNTER    480            // Number of clock cycles in one bit (one symbol with PAM)
+                                        // Here it also represents the bit rate of transmission (CLOCK_SPEED / TIMER_COUNTER)
+                                        // With RATE_ADAPT it is only the start-up (and slowest) rate
+#define SYMBOL_PERIOD    ((TIMER_COUNTER * GROUP_BITS / GROUP_SYMBOLS / LEVEL_BITS) >> LINK_RATE)      // Number of clock cycles in one symbol (Don't change this)
+// ----------------------------------------------------------
+// ----------- SELECT LINE CODE (same as the sender) --------
+#define LINE_NRZ                0       // One symbol per bit, LED on for a 1
+#define LINE_MANCHESTER         1       // 0 = on/off, 1 = off/on (IEEE 802.3), an edge in the middle of every bit
+#define LINE_DIFF_MANCHESTER    2       // Edge in the middle of every bit, an extra edge at the start of a 0
+#define LINE_4B5B               3       // Every 4 bits sent as 5 NRZI symbols, an edge at least every 4 symbols
+#define LINE_8B10B              4       // Every byte sent as 10 symbols, DC balanced (running disparity), an edge at least every 5 symbols
+#define LINE_4PPM               5       // Every 2 bits sent as one pulse in 4 slots, the LED is on a quarter of the time
+#define LINE_16PPM              6       // Every 4 bits sent as one pulse in 16 slots, slots are TIMER_COUNTER / 4 (use TX_DMA and RX_CAPTURE)
+#define LINE_4PAM               7       // Every 2 bits sent as one of 4 light levels, TIMER_COUNTER is then one symbol (TX_DMA and RX_SAMPLING only)
+#define LINE_8PAM               8       // Every 3 bits sent as one of 8 light levels
+#define LINE_CODE               LINE_NRZ
+
+#define PULSE_POSITION     (LINE_CODE == LINE_4PPM || LINE_CODE == LINE_16PPM)      // (Don't change this)
+#define PULSE_AMPLITUDE    (LINE_CODE == LINE_4PAM || LINE_CODE == LINE_8PAM)       // (Don't change this)
+
+#if LINE_CODE == LINE_MANCHESTER || LINE_CODE == LINE_DIFF_MANCHESTER
+#define SYMBOLS_PER_BIT    2
+#else
+#define SYMBOLS_PER_BIT    1            // The block codes and PPM only cover the header and the block, the framing bits stay NRZ
+#endif
+
+#if LINE_CODE == LINE_4B5B
+#define GROUP_BITS       4
+#define GROUP_SYMBOLS    5
+#elif LINE_CODE == LINE_8B10B
+#define GROUP_BITS       8
+#define GROUP_SYMBOLS    10
+#elif LINE_CODE == LINE_4PPM
+#define GROUP_BITS       2
+#define GROUP_SYMBOLS    4
+#elif LINE_CODE == LINE_16PPM
+#define GROUP_BITS       4
+#define GROUP_SYMBOLS    16
+#elif LINE_CODE == LINE_4PAM
+#define GROUP_BITS       2
+#define GROUP_SYMBOLS    1
+#elif LINE_CODE == LINE_8PAM
+#define GROUP_BITS       3
+#define GROUP_SYMBOLS    1
+#else
+#define GROUP_BITS       1
+#define GROUP_SYMBOLS    SYMBOLS_PER_BIT
+#endif
+
+#if PULSE_AMPLITUDE
+#define LEVEL_BITS       GROUP_BITS     // Bits in the amplitude of one symbol, the symbol clock stays at TIMER_COUNTER
+#define PAM_LEVELS       (1 << GROUP_BITS)
+#define TRAINING_ROUNDS  4              // Every level is sent this many times after the sync word to calibrate the receiver (at most 4)
+#define TRAINING_SYMBOLS (PAM_LEVELS * TRAINING_ROUNDS)
+#else
+#define LEVEL_BITS       1
+#define TRAINING_SYMBOLS 0
+#endif
+// ----------------------------------------------------------
+// ----------- CLOCK RECOVERY -------------------------------
+#define CLOCK_RECOVERY   1              // 0 = jump TA0R to the middle of the symbol on every edge
+                                        // 1 = track the sender's phase and frequency on every edge
+#define PLL_PHASE_GAIN   2              // Part of the phase error corrected on each edge (1 / x)
+#define PLL_FREQ_GAIN    32             // Part of the summed phase error added to the symbol period (1 / x)
+#define PLL_FREQ_LIMIT   (SYMBOL_PERIOD / 16)       // Largest symbol period correction (cycles)
+#define EDGE_LATENCY     8              // Cycles between an edge and the TA0R read in Port_2
+// ----------------------------------------------------------
+// ----------- SELECT RECEIVE ENGINE ------------------------
+#define RX_SAMPLING    0                // P2.4 is read in the middle of every symbol, TA0R re-phased on edges
+#define RX_CAPTURE     1                // TA2.2 (P2.5, tied to P2.4) timestamps every edge, DMA0 stores them
+#define RX_ENGINE      RX_SAMPLING
+
+#if PULSE_AMPLITUDE && RX_ENGINE == RX_CAPTURE
+#error "Edge timestamps carry no light level, PAM needs RX_SAMPLING and the ADC12"
+#endif
+
+#define CAPTURE_DIVIDER    8                                        // TA2 counts SMCLK / 8, a frame fits in 16 bits
+#define SYMBOL_COUNTS      (SYMBOL_PERIOD / CAPTURE_DIVIDER)        // (Don't change this)
+#define CAPTURE_CHUNK      (32 * TIMER_COUNTER / CAPTURE_DIVIDER)   // Edges are decoded every 32 bits
+#define EDGE_BUFFER_SIZE   (FRAME_SYMBOLS + 16)                     // Room for a few glitches (Don't change this)
+
+#define OVERSAMPLING       1                                        // P2.4 reads per symbol with RX_SAMPLING, 1 or 3 to 8 (odd is best)
+                                                                    // TA1 makes DMA0 copy P2IN, the majority is taken at the usual wakeup
+#define SAMPLE_PERIOD      (SYMBOL_PERIOD / OVERSAMPLING)           // (Don't change this)
+#define SAMPLE_RING        16                                       // (bytes) P2IN copies kept by DMA0, at least OVERSAMPLING
+#define VOTING             (OVERSAMPLING > 1 && RX_ENGINE == RX_SAMPLING && !SOFT_DECISION && !PULSE_AMPLITUDE)  // The ADC12 still wants one mid-symbol tick (Don't change this)
+#define EDGE_PHASE         (VOTING ? SAMPLE_PERIOD / 4 : SYMBOL_PERIOD / 2)     // TA0R at a symbol edge, the tick ends the symbol when voting (Don't change this)
 // ----------------------------------------------------------
 // ----------- UART TRANSMISSION ----------------------------
 #define UART_BAUD_RATE   115200      // (bit/s) - the communication with the computer
 // ----------------------------------------------------------
+// ----------- SELECT FOUNTAIN CODE (same as the sender) ----
+#define FOUNTAIN         0              // 1 = one-way bulk transfer, frames carry LT coded symbols of FOUNTAIN_K buffers
+#define FOUNTAIN_K       16             // Buffers (source symbols) in one block (16 max)
+#define FOUNTAIN_PENDING (2 * FOUNTAIN_K)       // Coded symbols kept until they can be peeled
+#define FOUNTAIN_C       0.1            // Robust soliton degree distribution constants
+#define FOUNTAIN_DELTA   0.5
+#define FOUNTAIN_HEADER  3              // (bytes) block number and symbol id, in front of the coded symbol (Don't change this)
+#define FOUNTAIN_SYMBOL_SIZE (BUFFER_SIZE - FOUNTAIN_HEADER)    // (bytes) a whole sender buffer, length included (Don't change this)
+#define FOUNTAIN_ALL     (unsigned int)((1ul << FOUNTAIN_K) - 1)   // (Don't change this)
+// ----------------------------------------------------------
+// ----------- SELECT ARQ (same as the sender) --------------
+#define ARQ              0              // 1 = selective repeat, frames are numbered and acked on UCA0 (not with FOUNTAIN)
+#define ARQ_WINDOW       8              // Frames held until the missing ones before them come again (2, 4 or 8)
+#define ARQ_BAUD_RATE    9600           // (bit/s) return channel on UCA0, P3.3 = UCA0TXD to the sender's P3.4
+#define ARQ_HEADER       (ARQ ? 1 : 0)  // (bytes) sequence number, in front of the data (Don't change this)
+#define ARQ_ACK_MARK     0xA5           // First byte of an ack, then next expected number, bitmap, number of the acked frame, check
+#define ARQ_ACK_SIZE     5              // (bytes) (Don't change this)
+
+#if ARQ && FOUNTAIN
+#error "FOUNTAIN is one-way and ARQ resends lost frames, select one"
+#endif
+// ----------------------------------------------------------
+// ----------- SELECT RATE ADAPTATION (same as the sender) --
+#define RATE_ADAPT       0              // 1 = the sender picks the rate and tells us in link frames, in steps of x2 (needs ARQ and RX_SAMPLING)
+#define RATE_STEPS       1              // Rates above TIMER_COUNTER: / 2, / 4 ... (SYMBOL_PERIOD >> RATE_STEPS must leave RX_SYMBOL_CYCLES)
+#define RATE_SILENCE_MS  200            // (ms) without a good frame, back to TIMER_COUNTER (the sender gives up on the rate sooner)
+#define LINK_SYNC_WORD   ((sync_word)~SYNC_WORD)       // Link frames start with the inverted sync word (Don't change this)
+#define LINK_FRAME       2              // frame_found for a link frame (Don't change this)
+#define LINK_SIZE        2              // (bytes) payload of a link frame: the next rate, then the copies still to come (Don't change this)
+#define LINK_SYMBOLS     ((1 + PREAMBLE_BITS + SYNC_BITS + 1) * SYMBOLS_PER_BIT + TRAINING_SYMBOLS \
+                          + (HEADER_BITS + BLOCK_BITS(LINK_SIZE + sizeof(crc)) + GROUP_BITS - 1) / GROUP_BITS * GROUP_SYMBOLS)   // Shortest a link frame is on the air (Don't change this)
+#define RX_SYMBOL_CYCLES (150 + (VOTING ? 12 * OVERSAMPLING : 0))  // (cycles) TA0 tick, wakeup and readSymbol() up to the next symbol, estimate (Don't change this)
+#if RATE_ADAPT
+#define LINK_RATE        link_rate      // (Don't change this)
+#else
+#define LINK_RATE        0
+#endif
+
+#if RATE_ADAPT && !ARQ
+#error "RATE_ADAPT is driven by the resends of the sender, it needs ARQ"
+#endif
+#if RATE_ADAPT && RX_ENGINE == RX_CAPTURE
+#error "RATE_ADAPT needs RX_SAMPLING, its TA0 tick times the silence that brings the rate back"
+#endif
+#if RATE_ADAPT && RX_SYMBOL_CYCLES > (TIMER_COUNTER * GROUP_BITS / GROUP_SYMBOLS / LEVEL_BITS) >> RATE_STEPS
+#error "The symbols of the fastest rate are shorter than RX_SAMPLING needs to wake up and read one, lower RATE_STEPS or raise TIMER_COUNTER"
+#endif
+// ----------------------------------------------------------
+// ----------- SELECT ADDRESSING (same as the sender) -------
+#define ADDRESSING        0             // 1 = the header also holds the destination, frames for other nodes are slept through
+#define NODE_ADDRESS      0x01          // This node (0x00 to 0xEF)
+#define NODE_GROUPS       0x0000        // Multicast groups this node is in (bit n = address ADDRESS_GROUP + n)
+#define ADDRESS_GROUP     0xF0          // First multicast group address
+#define ADDRESS_BROADCAST 0xFF          // Every node
+#define REMAINING_SYMBOLS(length) (((HEADER_BITS + BLOCK_BITS((length) + sizeof(crc)) + GROUP_BITS - 1) / GROUP_BITS \
+                                    - (HEADER_BITS + GROUP_BITS - 1) / GROUP_BITS) * GROUP_SYMBOLS)  // Symbols after the header, stop bit aside (Don't change this)
+// ----------------------------------------------------------
 // ----------- SELECT BUFFER SIZE ---------------------------
-#define BUFFER_SIZE    32               // (bytes)
-#define PACKET_SIZE    1 + BUFFER_SIZE * 8 + sizeof(crc) * 8 + 1        // (bits)
+#define BUFFER_SIZE    32               // (bytes) longest payload of a frame (255 max, same as the sender)
+#define HEADER_SIZE    (1 + ADDRESSING) // (bytes) payload length and destination, received before the data and covered by the crc
 // ----------------------------------------------------------
 // ----------- SELECT START/STOP BITS -----------------------
 #define START_BIT      1
 #define STOP_BIT       0
 // ----------------------------------------------------------
-// ----------- CRC ------------------------------------------
-typedef char crc;                   // Decides of the size of the crc (8 or 16 only)
-#define POLYNOMIAL 0x31                 // The generator polynomial
+// ----------- SELECT PREAMBLE/SYNC WORD (same as the sender)
+typedef unsigned int sync_word;         // Decides of the size of the sync word (unsigned long for 32 bits)
+#define PREAMBLE_BITS  8                // Alternating bits sent after the start bit
+#define SYNC_WORD      0x1F35           // Barker 13, sent LSB first after the preamble
+#define SYNC_BITS      (8 * sizeof(sync_word))      // (Don't change this)
+#define SYNC_THRESHOLD 2                // Number of wrong bits still accepted as the sync word
+#define SYNC_SLACK     8                // Extra bits searched in case we woke up on a glitch just before the frame
+#define IDLE_BITS      8                // That many 0 in a row while searching means the light is idle
+
+#define FRAME_BITS     (1 + PREAMBLE_BITS + SYNC_BITS + SYNC_SLACK + HEADER_BITS + BLOCK_BITS(BUFFER_SIZE + sizeof(crc)) + 1)      // (bits) longest frame (Don't change this)
+#define FRAME_SYMBOLS  ((FRAME_BITS - HEADER_BITS - BLOCK_BITS(BUFFER_SIZE + sizeof(crc))) * SYMBOLS_PER_BIT \
+                        + TRAINING_SYMBOLS + (HEADER_BITS + BLOCK_BITS(BUFFER_SIZE + sizeof(crc)) + GROUP_BITS - 1) / GROUP_BITS * GROUP_SYMBOLS)      // (Don't change this)
+// ----------------------------------------------------------
+// ----------- CRC (same as the sender) ---------------------
+#define CRC_16         0                // CRC-16-CCITT from the CRC module, fed by DMA
+#define CRC_32         1                // CRC-32 in software (no CRC32 module on the F5529)
+#define CRC_TYPE       CRC_16
+#define CRC_SEED       0xFFFF           // CRC-16 initial value, catches leading zero bytes
+#if CRC_TYPE == CRC_16
+typedef uint16_t crc;
+#else
+typedef uint32_t crc;
+#endif
+#define POLYNOMIAL 0x04C11DB7           // The CRC-32 generator polynomial
 #define WIDTH  (8 * sizeof(crc))        // The crc's width (Don't change this)
-#define TOPBIT (1 << (WIDTH - 1))       // Leftmost bit (Don't change this)
+#define TOPBIT ((crc)1 << (WIDTH - 1))  // Leftmost bit (Don't change this)
+// ----------------------------------------------------------
+// ----------- SELECT SCRAMBLER (same as the sender) --------
+#define SCRAMBLER       0               // 1 = payload and crc go through a self-synchronizing x^7 + x^6 + 1 scrambler
+#define SCRAMBLER_SEED  0x55            // Last 7 scrambled bits before the first byte, neither all 0s nor all 1s
+// ----------------------------------------------------------
+// ----------- SELECT ERROR CORRECTION (same as the sender)
+#define FEC_NONE       0                // Length, data and crc are received as they are
+#define FEC_HAMMING    1                // Extended Hamming(8,4) on every nibble, corrects 1 and detects 2 wrong bits
+#define FEC_REED_SOLOMON 2              // RS over GF(256) on the whole frame, corrects RS_PARITY / 2 wrong bytes (bursts)
+#define FEC_CONVOLUTIONAL 3             // Rate 1/2 convolutional code, soft decision Viterbi decoding from ADC12 samples
+#define FEC            FEC_NONE
+
+#define RS_PARITY      8                // (bytes) added to every frame, even (HEADER_SIZE + BUFFER_SIZE + crc + RS_PARITY <= 255), 18 at most at TIMER_COUNTER 480 or rsFeed() outlasts a symbol
+#define HEADER_COPIES  3                // With RS or convolutional coding every header byte is sent 3 times and voted, the length tells where the codeword ends (Don't change this)
+#define RS_BLOCK_SIZE  (HEADER_SIZE + BUFFER_SIZE + sizeof(crc) + RS_PARITY)    // Longest codeword (Don't change this)
+#define RS_FEED_CYCLES (22 * RS_PARITY + 60)    // (cycles) rsFeed() and the way back to readSymbol(), estimate from Tools/sim/rs_bench (Don't change this)
+#if FEC == FEC_REED_SOLOMON && RS_FEED_CYCLES > (TIMER_COUNTER * GROUP_BITS / GROUP_SYMBOLS / LEVEL_BITS) >> (RATE_ADAPT ? RATE_STEPS : 0)
+#error "rsFeed() takes longer than a symbol at the fastest rate, lower RS_PARITY or RATE_STEPS"
+#endif
+#define CONV_K         5                // Constraint length, 3, 5 or 7 (2^(CONV_K-1) states per bit, 7 decodes slower than frames arrive at TIMER_COUNTER 480)
+#define TRACEBACK      32               // (bits) Viterbi decisions are final after that many, at least 5 * CONV_K
+#define SOFT_MAX       15               // Soft decisions go from 0 (sure 0) to SOFT_MAX (sure 1)
+#define LEVEL_AVERAGING 8               // ADC12 light levels follow 1/LEVEL_AVERAGING of each new sample
+
+#if CONV_K == 3
+#define CONV_POLY_A    07               // Generator polynomials, best free distance for CONV_K (Don't change this)
+#define CONV_POLY_B    05
+#elif CONV_K == 5
+#define CONV_POLY_A    023
+#define CONV_POLY_B    035
+#else
+#define CONV_POLY_A    0171
+#define CONV_POLY_B    0133
+#endif
+#define CONV_STATES    (1 << (CONV_K - 1))                  // (Don't change this)
+#define CONV_WORDS     ((CONV_STATES + 15) / 16)            // Survivor bits of one step (Don't change this)
+#define CONV_SAMPLES   BLOCK_BITS(BUFFER_SIZE + sizeof(crc))    // Longest coded block (Don't change this)
+#define CONV_UNREACHABLE 0x1000         // Path metric of the states the encoder can't start from
+#define SOFT_DECISION  (FEC == FEC_CONVOLUTIONAL && RX_ENGINE == RX_SAMPLING && LINE_CODE == LINE_NRZ)   // ADC12 is only read at the sampling tick, otherwise decisions are hard (Don't change this)
+
+#if FEC == FEC_HAMMING                  // Bits on the air for the length, and for that many bytes of data and crc (Don't change this)
+#define HEADER_BITS        (HEADER_SIZE * 16)
+#define BLOCK_BITS(bytes)  ((bytes) * 16)
+#elif FEC == FEC_REED_SOLOMON
+#define HEADER_BITS        (HEADER_COPIES * HEADER_SIZE * 8)
+#define BLOCK_BITS(bytes)  (((bytes) + RS_PARITY) * 8)
+#elif FEC == FEC_CONVOLUTIONAL
+#define HEADER_BITS        (HEADER_COPIES * HEADER_SIZE * 8)
+#define BLOCK_BITS(bytes)  (((bytes) * 8 + CONV_K - 1) * 2)
+#else
+#define HEADER_BITS        (HEADER_SIZE * 8)
+#define BLOCK_BITS(bytes)  ((bytes) * 8)
+#endif
+#define HAMMING_CORRECTED  0x10         // Flags of hamming_decode[], next to the nibble
+#define HAMMING_FAILED     0x20
+// ----------------------------------------------------------
+// ----------- SELECT INTERLEAVER (same as the sender) ------
+#define INTERLEAVE_ROWS  1              // Coded bits after the length are written in rows and sent by columns (1 = off)
+                                        // Neighbours on the air are then a row apart in the codewords, a burst is spread out
+#define INTERLEAVE_BYTES ((BLOCK_BITS(BUFFER_SIZE + sizeof(crc)) + 7) / 8)     // (Don't change this)
+#if INTERLEAVE_ROWS > 1 && FEC != FEC_CONVOLUTIONAL
+#define BLOCK_ROOM       INTERLEAVE_BYTES   // The coded block is put back in order in buffer[], which grows by INTERLEAVE_BYTES - BUFFER_SIZE (Don't change this)
+#else
+#define BLOCK_ROOM       BUFFER_SIZE        // (Don't change this)
+#endif
 // ----------------------------------------------------------
 
 
 //functions
 void receivePacket();
-void retrieveData();
+char waitForSync();
+unsigned int syncErrors(sync_word diff);
+void endReception();
+void armCapture();
+unsigned int capturedEdges();
+char readSymbol();
+char readBit();
+char readDataBit();
+void readGroup();
+void readTraining();
+char readByte();
+char readCodeBit();
+void readInterleaved(unsigned int bits);
+void interleaverStart(unsigned int bits);
+unsigned int interleaverNext();
+char readCodedByte();
+char descramble(char byte);
+char hammingDecode(char codeword);
+void readHeader();
+char forThisNode(unsigned char address);
+void skipFrame(unsigned int symbols);
+unsigned char gfMul(unsigned char a, unsigned char b);
+unsigned char gfDiv(unsigned char a, unsigned char b);
+void rsStart();
+void rsFeed(unsigned char byte);
+char rsDecode();
+unsigned char readSoftBit();
+void updateSoftScale();
+char parity(unsigned int value);
+void convInit();
+void traceBack(unsigned int last, unsigned int state, unsigned int length, unsigned int keep);
+void viterbiDecode(unsigned int nBytes);
 void crcInit();
-void verifyData(char const message[]);
+crc calculateChecksum(char const message[], int nBytes);
 void sendToComputer();
 void printError();
+void fountainReceive();
+void fountainPeel();
+void fountainStart(unsigned char block);
+void xorSymbol(char *symbol, char const *source);
+void copySymbol(char *symbol, char const *source);
+void sendBlock();
+void fountainInit();
+double solitonWeight(unsigned int degree, double spread, unsigned int spike);
+unsigned int fountainRandom();
+unsigned int fountainNeighbours(unsigned int id);
+void arqReceive();
+void arqDeliver(char const *frame);
+void arqSendAck();
+void linkReceive();
+void setRate(unsigned char rate);
 
 //attributes
-volatile unsigned char temp;
 volatile unsigned long i = 0;
+#if CRC_TYPE == CRC_32
 crc crcTable[256];
-char buffer[BUFFER_SIZE];
-char packet[PACKET_SIZE];    //start bit + data bits + crc + stop bit
+#endif
+char buffer[HEADER_SIZE + BLOCK_ROOM];      // Payload length (and destination), then the payload
+unsigned int frame_length;
 crc checksum;
 volatile unsigned int receiving, timer_active;
 volatile unsigned int packet_error, ready;
+char last_symbol;
+unsigned int group, group_fill;
+unsigned char scrambler_state;  // Last 7 received scrambled bits, oldest in bit 0
+#if PULSE_AMPLITUDE
+unsigned int pam_threshold[PAM_LEVELS - 1];     // ADC12 reading halfway between two light levels, from the training symbols
+#endif
+char frame_found;
+unsigned int false_starts;
+unsigned int bad_frames;            // Frames that failed, resent (ARQ) or made up for (FOUNTAIN) instead of reported to the computer
+unsigned int foreign_frames;        // Frames for other nodes, slept through
+volatile unsigned int skip_symbols;
+unsigned int edge_times[EDGE_BUFFER_SIZE];
+unsigned int edge_read, symbol_time;
+char rx_level;
+char samples[SAMPLE_RING];          // P2IN copies, written by DMA0 when VOTING
+int pll_integrator;
+unsigned int fec_corrected, fec_uncorrectable;     // Codewords fixed or given up on, for the debugger
 uint32_t smclk;
 
+#if FOUNTAIN
+// The peeling decoder needs more room than the frame buffer, it lives in the USB RAM (the USB module is off)
+#pragma DATA_SECTION(fountain_source, ".usbram")
+#pragma DATA_SECTION(fountain_pending, ".usbram")
+char fountain_source[FOUNTAIN_K][FOUNTAIN_SYMBOL_SIZE];             // Decoded sender buffers
+char fountain_pending[FOUNTAIN_PENDING][FOUNTAIN_SYMBOL_SIZE];      // Coded symbols still made of several buffers
+unsigned int fountain_mask[FOUNTAIN_PENDING];       // Buffers still in each pending symbol, 0 = free slot
+unsigned int fountain_decoded;                      // Buffers we have, FOUNTAIN_ALL = block done
+unsigned char fountain_block;
+char fountain_started;
+unsigned int fountain_lost;                         // Blocks given up on when the next one showed up, for the debugger
+unsigned int fountain_cdf[FOUNTAIN_K];              // Degree distribution, cumulative and scaled to 65535
+uint16_t fountain_random;                           // xorshift16 state, the sequence needs it 16 bits wide
+#endif
+
+#if ARQ
+char arq_frames[ARQ_WINDOW][HEADER_SIZE + BUFFER_SIZE];    // Frames that came before a missing one
+unsigned char arq_base;                 // Next sequence number for the computer
+unsigned char arq_held;                 // Frames waiting in arq_frames (bit = seq % ARQ_WINDOW)
+unsigned char arq_ack_next[ARQ_ACK_SIZE], arq_ack_out[ARQ_ACK_SIZE];    // Newest ack, ack on the wire
+volatile unsigned int arq_ack_pos;
+volatile char arq_ack_due;
+unsigned int arq_delivered, arq_duplicates;   // For the debugger
+#endif
+#if RATE_ADAPT
+unsigned char link_rate;                // 0 = TIMER_COUNTER, every step halves SYMBOL_PERIOD
+volatile unsigned long rate_silence;    // Symbols since the last good frame
+unsigned long rate_silence_limit;       // RATE_SILENCE_MS in symbols of this rate
+unsigned char link_next;                // Rate named by the link frames, taken after their last copy
+volatile unsigned int link_wait;        // Symbols until the last copy is over, 0 = no change waiting
+#endif
+
+#if LINE_CODE == LINE_4B5B
+// Nibble of every 5-symbol 4B5B code, 0xFF when it isn't one
+const unsigned char line_5b4b[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02, 0xFF, 0x0E, 0xFF, 0x08, 0x04, 0x0C, 0xFF, 0x0A, 0x06, 0x00,
+    0xFF, 0xFF, 0x01, 0xFF, 0xFF, 0x03, 0xFF, 0x0F, 0xFF, 0x09, 0x05, 0x0D, 0xFF, 0x0B, 0x07, 0xFF
+};
+#elif LINE_CODE == LINE_8B10B
+// Bits 0-4 of every 6-symbol sub-block (both disparities), 0xFF when it isn't one
+const unsigned char line_6b5b[64] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x00, 0x07, 0xFF, 0x10, 0x1F, 0x0B, 0x18, 0x0D, 0x0E, 0xFF,
+    0xFF, 0x01, 0x02, 0x13, 0x04, 0x15, 0x16, 0x17, 0x08, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0xFF,
+    0xFF, 0x1E, 0x1D, 0x03, 0x1B, 0x05, 0x06, 0x08, 0x17, 0x09, 0x0A, 0x04, 0x0C, 0x02, 0x01, 0xFF,
+    0xFF, 0x11, 0x12, 0x18, 0x14, 0x1F, 0x10, 0xFF, 0x07, 0x00, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+// Bits 5-7 of every 4-symbol sub-block (P7 and A7 both give 7), 0xFF when it isn't one
+const unsigned char line_4b3b[16] = {
+    0xFF, 0x07, 0x00, 0x03, 0x04, 0x05, 0x06, 0x07, 0x07, 0x01, 0x02, 0x04, 0x03, 0x00, 0x07, 0xFF
+};
+#endif
+
+#if FEC == FEC_HAMMING
+// Nibble of every extended Hamming(8,4) codeword, with HAMMING_CORRECTED or HAMMING_FAILED
+const char hamming_decode[256] = {
+    0x00, 0x10, 0x10, 0x20, 0x10, 0x20, 0x20, 0x11, 0x10, 0x21, 0x21, 0x11, 0x21, 0x11, 0x11, 0x01,
+    0x10, 0x20, 0x20, 0x12, 0x20, 0x14, 0x18, 0x20, 0x21, 0x19, 0x15, 0x21, 0x13, 0x21, 0x21, 0x11,
+    0x10, 0x22, 0x22, 0x12, 0x22, 0x1A, 0x16, 0x22, 0x23, 0x17, 0x1B, 0x23, 0x13, 0x23, 0x23, 0x11,
+    0x22, 0x12, 0x12, 0x02, 0x13, 0x22, 0x22, 0x12, 0x13, 0x23, 0x23, 0x12, 0x03, 0x13, 0x13, 0x23,
+    0x10, 0x24, 0x24, 0x1C, 0x24, 0x14, 0x16, 0x24, 0x25, 0x17, 0x15, 0x25, 0x1D, 0x25, 0x25, 0x11,
+    0x24, 0x14, 0x15, 0x24, 0x14, 0x04, 0x24, 0x14, 0x15, 0x25, 0x05, 0x15, 0x25, 0x14, 0x15, 0x25,
+    0x26, 0x17, 0x16, 0x26, 0x16, 0x26, 0x06, 0x16, 0x17, 0x07, 0x27, 0x17, 0x27, 0x17, 0x16, 0x27,
+    0x1E, 0x26, 0x26, 0x12, 0x26, 0x14, 0x16, 0x26, 0x27, 0x17, 0x15, 0x27, 0x13, 0x27, 0x27, 0x1F,
+    0x10, 0x28, 0x28, 0x1C, 0x28, 0x1A, 0x18, 0x28, 0x29, 0x19, 0x1B, 0x29, 0x1D, 0x29, 0x29, 0x11,
+    0x28, 0x19, 0x18, 0x28, 0x18, 0x28, 0x08, 0x18, 0x19, 0x09, 0x29, 0x19, 0x29, 0x19, 0x18, 0x29,
+    0x2A, 0x1A, 0x1B, 0x2A, 0x1A, 0x0A, 0x2A, 0x1A, 0x1B, 0x2B, 0x0B, 0x1B, 0x2B, 0x1A, 0x1B, 0x2B,
+    0x1E, 0x2A, 0x2A, 0x12, 0x2A, 0x1A, 0x18, 0x2A, 0x2B, 0x19, 0x1B, 0x2B, 0x13, 0x2B, 0x2B, 0x1F,
+    0x2C, 0x1C, 0x1C, 0x0C, 0x1D, 0x2C, 0x2C, 0x1C, 0x1D, 0x2D, 0x2D, 0x1C, 0x0D, 0x1D, 0x1D, 0x2D,
+    0x1E, 0x2C, 0x2C, 0x1C, 0x2C, 0x14, 0x18, 0x2C, 0x2D, 0x19, 0x15, 0x2D, 0x1D, 0x2D, 0x2D, 0x1F,
+    0x1E, 0x2E, 0x2E, 0x1C, 0x2E, 0x1A, 0x16, 0x2E, 0x2F, 0x17, 0x1B, 0x2F, 0x1D, 0x2F, 0x2F, 0x1F,
+    0x0E, 0x1E, 0x1E, 0x2E, 0x1E, 0x2E, 0x2E, 0x1F, 0x1E, 0x2F, 0x2F, 0x1F, 0x2F, 0x1F, 0x1F, 0x0F
+};
+#endif
+
+#if FEC == FEC_REED_SOLOMON
+unsigned char rs_block[RS_BLOCK_SIZE];         // Codeword as received, then as corrected
+unsigned char rs_syndrome[RS_PARITY];
+unsigned int rs_length;
+
+// Powers of the GF(256) generator a = 2, twice so that a product never needs a modulo
+const unsigned char gf_exp[512] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26,
+    0x4C, 0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0,
+    0x9D, 0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23,
+    0x46, 0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1,
+    0x5F, 0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0,
+    0xFD, 0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2,
+    0xD9, 0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE,
+    0x81, 0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC,
+    0x85, 0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54,
+    0xA8, 0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73,
+    0xE6, 0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF,
+    0xE3, 0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41,
+    0x82, 0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6,
+    0x51, 0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09,
+    0x12, 0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16,
+    0x2C, 0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01,
+    0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26, 0x4C,
+    0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0, 0x9D,
+    0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23, 0x46,
+    0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1, 0x5F,
+    0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0, 0xFD,
+    0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2, 0xD9,
+    0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE, 0x81,
+    0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC, 0x85,
+    0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54, 0xA8,
+    0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73, 0xE6,
+    0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF, 0xE3,
+    0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41, 0x82,
+    0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6, 0x51,
+    0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09, 0x12,
+    0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16, 0x2C,
+    0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01, 0x02
+};
+
+// Discrete logarithm of every non-zero GF(256) element
+const unsigned char gf_log[256] = {
+    0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1A, 0xC6, 0x03, 0xDF, 0x33, 0xEE, 0x1B, 0x68, 0xC7, 0x4B,
+    0x04, 0x64, 0xE0, 0x0E, 0x34, 0x8D, 0xEF, 0x81, 0x1C, 0xC1, 0x69, 0xF8, 0xC8, 0x08, 0x4C, 0x71,
+    0x05, 0x8A, 0x65, 0x2F, 0xE1, 0x24, 0x0F, 0x21, 0x35, 0x93, 0x8E, 0xDA, 0xF0, 0x12, 0x82, 0x45,
+    0x1D, 0xB5, 0xC2, 0x7D, 0x6A, 0x27, 0xF9, 0xB9, 0xC9, 0x9A, 0x09, 0x78, 0x4D, 0xE4, 0x72, 0xA6,
+    0x06, 0xBF, 0x8B, 0x62, 0x66, 0xDD, 0x30, 0xFD, 0xE2, 0x98, 0x25, 0xB3, 0x10, 0x91, 0x22, 0x88,
+    0x36, 0xD0, 0x94, 0xCE, 0x8F, 0x96, 0xDB, 0xBD, 0xF1, 0xD2, 0x13, 0x5C, 0x83, 0x38, 0x46, 0x40,
+    0x1E, 0x42, 0xB6, 0xA3, 0xC3, 0x48, 0x7E, 0x6E, 0x6B, 0x3A, 0x28, 0x54, 0xFA, 0x85, 0xBA, 0x3D,
+    0xCA, 0x5E, 0x9B, 0x9F, 0x0A, 0x15, 0x79, 0x2B, 0x4E, 0xD4, 0xE5, 0xAC, 0x73, 0xF3, 0xA7, 0x57,
+    0x07, 0x70, 0xC0, 0xF7, 0x8C, 0x80, 0x63, 0x0D, 0x67, 0x4A, 0xDE, 0xED, 0x31, 0xC5, 0xFE, 0x18,
+    0xE3, 0xA5, 0x99, 0x77, 0x26, 0xB8, 0xB4, 0x7C, 0x11, 0x44, 0x92, 0xD9, 0x23, 0x20, 0x89, 0x2E,
+    0x37, 0x3F, 0xD1, 0x5B, 0x95, 0xBC, 0xCF, 0xCD, 0x90, 0x87, 0x97, 0xB2, 0xDC, 0xFC, 0xBE, 0x61,
+    0xF2, 0x56, 0xD3, 0xAB, 0x14, 0x2A, 0x5D, 0x9E, 0x84, 0x3C, 0x39, 0x53, 0x47, 0x6D, 0x41, 0xA2,
+    0x1F, 0x2D, 0x43, 0xD8, 0xB7, 0x7B, 0xA4, 0x76, 0xC4, 0x17, 0x49, 0xEC, 0x7F, 0x0C, 0x6F, 0xF6,
+    0x6C, 0xA1, 0x3B, 0x52, 0x29, 0x9D, 0x55, 0xAA, 0xFB, 0x60, 0x86, 0xB1, 0xBB, 0xCC, 0x3E, 0x5A,
+    0xCB, 0x59, 0x5F, 0xB0, 0x9C, 0xA9, 0xA0, 0x51, 0x0B, 0xF5, 0x16, 0xEB, 0x7A, 0x75, 0x2C, 0xD7,
+    0x4F, 0xAE, 0xD5, 0xE9, 0xE6, 0xE7, 0xAD, 0xE8, 0x74, 0xD6, 0xF4, 0xEA, 0xA8, 0x50, 0x58, 0xAF
+};
+#endif
+
+#if FEC == FEC_CONVOLUTIONAL
+unsigned char soft_samples[CONV_SAMPLES];
+unsigned int conv_samples;
+unsigned char conv_out[BUFFER_SIZE + sizeof(crc)];         // Decoded payload and crc
+unsigned int conv_bits;
+unsigned int conv_decisions[2 * TRACEBACK][CONV_WORDS];     // Survivor path window
+unsigned char conv_output[2 * CONV_STATES];
+int adc_zero, adc_one;                                      // ADC12 reading of the light off and on
+long soft_scale;
+#endif
+
+#if INTERLEAVE_ROWS > 1
+char deinterleaved;                 // The coded bits are back in order in buffer[], behind the header, a decoded byte never overtakes them
+unsigned int code_pos;
+unsigned int il_bits, il_columns, il_column, il_row, il_index;
+#endif
+
 //interruption flags
 int USCI_A1_INT = 0;
 
@@ -63,7 +509,7 @@ int main(void) {
     // SET CLOCK
     UCS_initClockSignal(UCS_SMCLK, UCS_DCOCLK_SELECT, UCS_CLOCK_DIVIDER_1);    // Select SMCLK to be DCO
     PMM_setVCore(PMM_CORE_LEVEL_3);                                            // Set VCore Up to level 3 to be able to run higher than 20 MHz
-    UCS_initFLLSettle(CLOCK_FREQUENCY*2, CLOCK_FREQUENCY / 32768);             // Set clock source to selected frequency
+    UCS_initFLLSettle(CLOCK_FREQUENCY / 1000, CLOCK_FREQUENCY / 32768);        // Set clock source to selected frequency (kHz)
 
     smclk = UCS_getSMCLK();     //for test only
 
@@ -75,18 +521,66 @@ int main(void) {
     receiving = 0;
     timer_active = 0;
     packet_error = 0;
-
-    crcInit();
-    CRC_setSeed(CRC_BASE, 0x0000);
+    false_starts = 0;
+    bad_frames = 0;
+    foreign_frames = 0;
+    skip_symbols = 0;
+    fec_corrected = 0;
+    fec_uncorrectable = 0;
+#if FEC == FEC_CONVOLUTIONAL
+    convInit();
+    adc_zero = 0;                   // Full scale until the first frame tells us better, kept between frames
+    adc_one = 4095;
+    updateSoftScale();
+#endif
+    pll_integrator = 0;             // Kept between frames, the clock mismatch between the boards hardly moves
+#if FOUNTAIN
+    fountainInit();
+    fountain_started = 0;
+    fountain_lost = 0;
+#endif
+#if ARQ
+    arq_base = 0;
+    arq_held = 0;
+    arq_ack_pos = ARQ_ACK_SIZE;     // Nothing on the wire
+    arq_ack_due = 0;
+    arq_delivered = 0;
+    arq_duplicates = 0;
+#endif
+#if RATE_ADAPT
+    link_rate = 0;
+    rate_silence = 0;
+    link_wait = 0;
+#endif
 
     ready = 1;
 
 
+    // SET CRC
+#if CRC_TYPE == CRC_16
+    DMA_initParam crc_dma_param = {0};
+    crc_dma_param.channelSelect = DMA_CHANNEL_2;
+    crc_dma_param.transferModeSelect = DMA_TRANSFER_BLOCK;      // Whole frame buffer in one request
+    crc_dma_param.transferSize = HEADER_SIZE + BUFFER_SIZE;
+    crc_dma_param.triggerSourceSelect = DMA_TRIGGERSOURCE_0;    // DMAREQ, started by software
+    crc_dma_param.transferUnitSelect = DMA_SIZE_SRCBYTE_DSTBYTE;
+    crc_dma_param.triggerTypeSelect = DMA_TRIGGER_RISINGEDGE;
+    DMA_init(&crc_dma_param);
+    DMA_setDstAddress(DMA_CHANNEL_2, CRC_BASE + OFS_CRCDI_L, DMA_DIRECTION_UNCHANGED);
+#else
+    crcInit();
+#endif
+
+
     // SET A/D CONVERTER AND REF
     P6DIR &= ~BIT0;                         // Set P6.0 as input
     P6SEL |= BIT0;                          // Activate alternate function
     REFCTL0 &= ~REFMSTR;
+#if SOFT_DECISION || PULSE_AMPLITUDE
+    ADC12CTL0 = ADC12ON | ADC12SHT0_2 | ADC12REFON | ADC12REF2_5V;     // Short sampling, a conversion must fit in one symbol
+#else
     ADC12CTL0 = ADC12ON | ADC12SHT0_4 | ADC12REFON | ADC12REF2_5V;
+#endif
     ADC12CTL1 = ADC12SHP;
     ADC12MCTL0 = ADC12SREF_1 + ADC12INCH_0; // V+=Vref+  and  V-=AVss,
 
@@ -97,10 +591,47 @@ int main(void) {
 
 
     // SET TIMER
+#if RX_ENGINE == RX_SAMPLING
     TA0CCTL0 = CCIE;                        // CCR0 interrupt enabled
-    TA0CCR0 = TIMER_COUNTER;                // Sample 5000 times per second
+    TA0CCR0 = SYMBOL_PERIOD - 1;            // Sample every symbol (up mode counts CCR0 + 1)
     TA0CTL = TASSEL_2 + MC_1 + TACLR;
 
+#if VOTING
+    // SET DMA
+    DMA_initParam dma_param = {0};
+    dma_param.channelSelect = DMA_CHANNEL_0;
+    dma_param.transferModeSelect = DMA_TRANSFER_REPEATED_SINGLE;    // Wraps around samples forever
+    dma_param.transferSize = SAMPLE_RING;
+    dma_param.triggerSourceSelect = DMA_TRIGGERSOURCE_3;            // TA1CCR0 CCIFG
+    dma_param.transferUnitSelect = DMA_SIZE_SRCBYTE_DSTBYTE;
+    dma_param.triggerTypeSelect = DMA_TRIGGER_RISINGEDGE;
+    DMA_init(&dma_param);
+    DMA_setSrcAddress(DMA_CHANNEL_0, (uint32_t)(uintptr_t)&P2IN, DMA_DIRECTION_UNCHANGED);
+    DMA_setDstAddress(DMA_CHANNEL_0, (uint32_t)(uintptr_t)samples, DMA_DIRECTION_INCREMENT);
+    DMA_enableTransfers(DMA_CHANNEL_0);
+
+    TA1CCR0 = SAMPLE_PERIOD - 1;            // OVERSAMPLING P2IN copies per symbol, no interrupt
+    TA1CTL = TASSEL_2 + MC_1 + TACLR;
+#endif
+#else
+    P2DIR &= ~BIT5;                         // P2.5 = TA2.2 capture input
+    P2SEL |= BIT5;
+    TA2CCTL2 = CM_3 + CCIS_0 + SCS + CAP;   // Capture both edges of CCI2A, synchronized to the timer clock
+    TA2CTL = TASSEL_2 + ID_3 + MC_2 + TACLR;    // SMCLK / CAPTURE_DIVIDER, continuous mode
+
+    // SET DMA
+    DMA_initParam dma_param = {0};
+    dma_param.channelSelect = DMA_CHANNEL_0;
+    dma_param.transferModeSelect = DMA_TRANSFER_SINGLE;         // One timestamp per capture
+    dma_param.transferSize = EDGE_BUFFER_SIZE;
+    dma_param.triggerSourceSelect = DMA_TRIGGERSOURCE_6;        // TA2CCR2 CCIFG
+    dma_param.transferUnitSelect = DMA_SIZE_SRCWORD_DSTWORD;
+    dma_param.triggerTypeSelect = DMA_TRIGGER_RISINGEDGE;
+    DMA_init(&dma_param);
+    DMA_setSrcAddress(DMA_CHANNEL_0, (uint32_t)(uintptr_t)&TA2CCR2, DMA_DIRECTION_UNCHANGED);
+    armCapture();
+#endif
+
 
     // SET UART
     P4SEL |= BIT4 + BIT5;                           // P4.4 = TX  and  P4.5 = RX
@@ -113,6 +644,18 @@ int main(void) {
     UCA1MCTL |= modulation + UCBRF_0;               // Select the correct modulation
     UCA1CTL1 &= ~UCSWRST;                           // Start the UART state machine
     UCA1IE |= UCRXIE;                               // Enable USCI_A1 RX interrupts
+#if ARQ
+    // SET RETURN CHANNEL, acks to the sender
+    P3SEL |= BIT3;                                  // P3.3 = UCA0TXD
+    UCA0CTL1 |= UCSWRST;
+    UCA0CTL1 |= UCSSEL_2;                           // SMCLK
+    n = CLOCK_FREQUENCY / ARQ_BAUD_RATE;
+    UCA0BR0 = (int)(n) & 0xFF;
+    UCA0BR1 = (int)(n) >> 8;
+    modulation = round((n - (int)(n))*8);
+    UCA0MCTL |= modulation + UCBRF_0;
+    UCA0CTL1 &= ~UCSWRST;
+#endif
 
 
     P2DIR &= ~BIT4;     //input pin (P2.4)
@@ -129,11 +672,34 @@ int main(void) {
 
         receivePacket();
 
-        if (packet_error == 0) {
+        if (frame_found == 0) {
+            // False start, the light glitched but no sync word followed
+        }
+#if RATE_ADAPT
+        else if (frame_found == LINK_FRAME) {
+            if (packet_error == 0) {
+                linkReceive();
+            }
+        }
+#endif
+        else if (packet_error == 0) {
+#if RATE_ADAPT
+            rate_silence = 0;
+#endif
+#if FOUNTAIN
+            fountainReceive();
+#elif ARQ
+            arqReceive();
+#else
             sendToComputer();
+#endif
         }
         else {
+#if !ARQ && !FOUNTAIN
             printError();
+#else
+            bad_frames++;               // The computer only ever sees good data, in order
+#endif
         }
 
         packet_error = 0;
@@ -149,9 +715,68 @@ __interrupt void Port_2(void)
 {
     if (receiving == 0) {
         receiving = 1;
+#if CLOCK_RECOVERY
+        TA0R = EDGE_PHASE + EDGE_LATENCY;           // Adjust timer to middle of symbol
+#else
+        TA0R = EDGE_PHASE;                          // Adjust timer to middle of symbol
+#endif
+#if RX_ENGINE == RX_CAPTURE
+        // DMA0 already stored this edge, the rest of the frame is only timestamped
+        edge_read = capturedEdges();
+        symbol_time = (edge_read ? edge_times[edge_read - 1] : TA2R) + SYMBOL_COUNTS / 2;
+        rx_level = 1;
+        P2IE &= ~BIT4;
+        TA2CCR0 = TA2R + CAPTURE_CHUNK;
+        TA2CCTL0 = CCIE;
+#endif
         __bic_SR_register_on_exit(LPM0_bits);
     }
-    TA0R = TIMER_COUNTER / 2;       // Adjust timer to middle of bit
+    else {
+#if CLOCK_RECOVERY
+        // The edge should have come half a symbol after the last sample. Move the next samples
+        // part of the way towards it, and let the sum of the errors stretch the symbol period.
+        int phase_error = (int)TA0R - (EDGE_PHASE + EDGE_LATENCY);      // > 0 when the edge is late
+#if VOTING
+        if (phase_error > SYMBOL_PERIOD / 2) {
+            phase_error -= TA0CCR0 + 1;             // Early edge, the tick of the last symbol is still to come
+        }
+#endif
+        TA0R -= phase_error / PLL_PHASE_GAIN;
+#if VOTING
+        if (TA0R > TA0CCR0) {
+            TA0R -= TA0CCR0 + 1;
+            TA0CCTL0 |= CCIFG;                      // Moved past that tick, its samples are all in
+        }
+#endif
+
+        pll_integrator += phase_error;
+        if (pll_integrator > PLL_FREQ_LIMIT * PLL_FREQ_GAIN) {
+            pll_integrator = PLL_FREQ_LIMIT * PLL_FREQ_GAIN;
+        }
+        else if (pll_integrator < -PLL_FREQ_LIMIT * PLL_FREQ_GAIN) {
+            pll_integrator = -PLL_FREQ_LIMIT * PLL_FREQ_GAIN;
+        }
+        TA0CCR0 = SYMBOL_PERIOD - 1 + pll_integrator / PLL_FREQ_GAIN;
+#else
+#if VOTING
+        if (TA0R > SYMBOL_PERIOD / 2) {
+            TA0CCTL0 |= CCIFG;          // Early edge, don't skip the tick of the last symbol
+        }
+#endif
+        TA0R = EDGE_PHASE;              // Adjust timer to middle of symbol
+#endif
+    }
+#if VOTING
+    TA1R = SAMPLE_PERIOD / 2 + EDGE_LATENCY;    // Samples halfway between two edges
+#endif
+#if SYMBOLS_PER_BIT == 2
+    if (P2IN & BIT4) {              // Every edge is a symbol boundary, so follow both directions
+        P2IES |= BIT4;
+    }
+    else {
+        P2IES &= ~BIT4;
+    }
+#endif
     P2IFG &= (~BIT4); // P2.4 IFG clear
 }
 
@@ -172,10 +797,66 @@ __interrupt void USCI_A1_ISR(void)
     }
 }
 
+#if ARQ
+// Sends the ack bytes one by one, then the newest ack if another frame came meanwhile
+#pragma vector=USCI_A0_VECTOR
+__interrupt void USCI_A0_ISR(void)
+{
+    unsigned int pos;
+
+    switch(__even_in_range(UCA0IV, 4))
+    {
+    case 4 :                        // Vector 4 - TXIFG
+        if (arq_ack_pos == ARQ_ACK_SIZE) {
+            if (!arq_ack_due) {
+                UCA0IE &= ~UCTXIE;
+                break;
+            }
+            for (pos = 0; pos < ARQ_ACK_SIZE; pos++) {
+                arq_ack_out[pos] = arq_ack_next[pos];
+            }
+            arq_ack_due = 0;
+            arq_ack_pos = 0;
+        }
+        UCA0TXBUF = arq_ack_out[arq_ack_pos++];
+        break;
+    default : break;
+    }
+}
+#endif
+
+// Timer2 A0 interrupt service routine
+// Wakes the CPU every CAPTURE_CHUNK during a frame to decode the edges captured so far
+#pragma vector=TIMER2_A0_VECTOR
+__interrupt void TIMER2_A0_ISR(void)
+{
+    TA2CCR0 += CAPTURE_CHUNK;
+    if (receiving) {
+        __bic_SR_register_on_exit(LPM0_bits);
+    }
+}
+
 // Timer0 A0 interrupt service routine
 #pragma vector=TIMER0_A0_VECTOR
 __interrupt void TIMER0_A0_ISR(void)
 {
+#if RATE_ADAPT
+    if (link_rate != 0 && ++rate_silence >= rate_silence_limit && !receiving) {
+        setRate(0);                 // The sender went back to TIMER_COUNTER too, or will soon
+    }
+    if (link_wait > 1) {
+        link_wait--;
+    }
+    else if (link_wait == 1 && !receiving) {
+        setRate(link_next);         // The last copy was lost, the sender is on the new rate by now
+    }
+#endif
+    if (skip_symbols != 0) {
+        skip_symbols--;             // Frame for another node, only wake up at its end
+        if (skip_symbols != 0) {
+            return;
+        }
+    }
     if (receiving && (__get_SR_register_on_exit() & CPUOFF)) {
         __bic_SR_register_on_exit(LPM0_bits);
     }
@@ -183,66 +864,886 @@ __interrupt void TIMER0_A0_ISR(void)
 
 void receivePacket() {
 
-    CRC_setSeed(CRC_BASE, 0x0000);      // Reset CRC signature
-
     // start bit
-    __bis_SR_register(LPM0_bits + GIE);       // CPU off, enable interrupts
-                                              //always wait for the right time to acquire data
-    if(((P2IN & BIT4) >> 4) != START_BIT) {
+#if SYMBOLS_PER_BIT == 1
+    if(readSymbol() != START_BIT) {
+        packet_error = 1;
+    }
+#else
+    // The rising edge that woke us up was the middle of the start bit, only its second half is left
+    last_symbol = readSymbol();
+    if(last_symbol != START_BIT) {
         packet_error = 1;
     }
+#endif
+
+    // preamble and sync word
+    frame_found = packet_error ? 0 : waitForSync();
+    if (!frame_found) {
+        false_starts++;
+        packet_error = 0;
+        endReception();
+        return;
+    }
 
+#if PULSE_AMPLITUDE
+    // light levels of this frame
+    readTraining();
+#endif
+
+    // length and destination
+#if INTERLEAVE_ROWS > 1
+    deinterleaved = 0;
+#endif
+    group_fill = 0;
+    readHeader();
+    frame_length = (unsigned char)buffer[0];
+    if (packet_error || frame_length == 0 || frame_length > BUFFER_SIZE) {
+        packet_error = 1;               // Don't wait for data that the sender never meant to send
+        endReception();
+        return;
+    }
+#if ADDRESSING
+    if (!forThisNode(buffer[1])) {
+        foreign_frames++;
+        skipFrame(REMAINING_SYMBOLS(frame_length));
+        frame_found = 0;                // Nothing for the computer, nothing wrong either
+        endReception();
+        return;
+    }
+#endif
+
+#if INTERLEAVE_ROWS > 1
+    // The whole block is needed before the first codeword is complete
+    readInterleaved(BLOCK_BITS(frame_length + sizeof(crc)));
+#endif
+
+#if FEC == FEC_CONVOLUTIONAL
+    // data bits, checksum and tail, decoded once the light is idle
+    conv_samples = BLOCK_BITS(frame_length + sizeof(crc));
+#if INTERLEAVE_ROWS == 1
+    for (i = 0; i < conv_samples; i++) {
+        soft_samples[i] = readSoftBit();
+    }
+#endif
+#else
     // data bits
-    temp = 0;
-    for (i = 1; i < BUFFER_SIZE * 8 + 1; i++) {
-        __bis_SR_register(LPM0_bits + GIE);       // CPU off, enable interrupts
-                                                  //always wait for the right time to acquire data
-        temp |= ((P2IN & BIT4) >> 4) << ((i-1) % 8);
-        if (i % 8 == 0) {
-            buffer[(i / 8) - 1] = temp;
-            CRC_set8BitData(CRC_BASE, temp);        // Calculate CRC for this byte
-            temp = 0;
-        }
+    for (i = HEADER_SIZE; i < HEADER_SIZE + frame_length; i++) {
+        buffer[i] = readCodedByte();
     }
 
     // checksum
     checksum = 0;
-    crc true_checksum = (crc)CRC_getResult(CRC_BASE);
-    for (i = 0; i < sizeof(crc) * 8; i++) {
-        __bis_SR_register(LPM0_bits + GIE);       // CPU off, enable interrupts
-                                                  //always wait for the right time to acquire data
-        checksum |= ((P2IN & BIT4) >> 4) << i;
+    for (i = 0; i < sizeof(crc); i++) {
+        checksum |= (crc)(unsigned char)readCodedByte() << (i * 8);
+    }
+#endif
+
+#if FEC == FEC_REED_SOLOMON
+    // parity
+    for (i = 0; i < RS_PARITY; i++) {
+        rsFeed(readByte());
     }
-    if(checksum != true_checksum){
+#endif
+
+    // stop bit
+    if(readBit() != STOP_BIT) {
         packet_error = 1;
     }
 
+    endReception();
 
-    // stop bit
-    __bis_SR_register(LPM0_bits + GIE);       // CPU off, enable interrupts
-                                              //always wait for the right time to acquire data
-    if(((P2IN & BIT4) >> 4) != STOP_BIT) {
+#if FEC == FEC_REED_SOLOMON
+    // The light is idle, there is time to fix the codeword
+    if (rsDecode()) {
+        for (i = 0; i < HEADER_SIZE + frame_length; i++) {
+            buffer[i] = rs_block[i];
+        }
+        checksum = 0;
+        for (i = 0; i < sizeof(crc); i++) {
+            checksum |= (crc)rs_block[HEADER_SIZE + frame_length + i] << (i * 8);
+        }
+    }
+    else {
+        fec_uncorrectable++;
         packet_error = 1;
     }
+#elif FEC == FEC_CONVOLUTIONAL
+    viterbiDecode(frame_length + sizeof(crc));
+    updateSoftScale();              // Levels moved during this frame, ready for the next one
+    for (i = 0; i < frame_length; i++) {
+        buffer[HEADER_SIZE + i] = conv_out[i];
+    }
+    checksum = 0;
+    for (i = 0; i < sizeof(crc); i++) {
+        checksum |= (crc)conv_out[frame_length + i] << (i * 8);
+    }
+#endif
+
+#if SCRAMBLER
+    // Same order as the sender: payload, then the crc bytes
+    scrambler_state = SCRAMBLER_SEED;
+    for (i = HEADER_SIZE; i < HEADER_SIZE + frame_length; i++) {
+        buffer[i] = descramble(buffer[i]);
+    }
+    crc scrambled = checksum;
+    checksum = 0;
+    for (i = 0; i < sizeof(crc); i++) {
+        checksum |= (crc)(unsigned char)descramble(scrambled >> (i * 8)) << (i * 8);
+    }
+#endif
+
+    if(checksum != calculateChecksum(buffer, HEADER_SIZE + frame_length)){
+        packet_error = 1;
+    }
+}
+
+// Slides the received bits through a shift register until they match SYNC_WORD with at most
+// SYNC_THRESHOLD wrong bits. Gives up as soon as the light looks idle, so that a glitch only
+// costs a few bit times. Returns 1, or LINK_FRAME for LINK_SYNC_WORD.
+char waitForSync() {
+
+    sync_word shift = 0;
+    unsigned int n;
+
+    for (n = 1; n <= PREAMBLE_BITS + SYNC_BITS + SYNC_SLACK; n++) {
+
+        shift = (shift >> 1) | ((sync_word)readBit() << (SYNC_BITS - 1));     // Sent LSB first
+
+        if (packet_error) {
+            return 0;               // Line code violation, not a frame
+        }
+        if (n >= IDLE_BITS && (shift >> (SYNC_BITS - IDLE_BITS)) == 0) {
+            return 0;
+        }
+        if (n >= SYNC_BITS) {
+            if (syncErrors(shift ^ SYNC_WORD) <= SYNC_THRESHOLD) {
+                return 1;
+            }
+#if RATE_ADAPT
+            if (syncErrors(shift ^ LINK_SYNC_WORD) <= SYNC_THRESHOLD) {
+                return LINK_FRAME;
+            }
+#endif
+        }
+    }
+
+    return 0;
+}
+
+// Wrong bits, counting stops past SYNC_THRESHOLD
+unsigned int syncErrors(sync_word diff) {
+
+    unsigned int errors;
+    for (errors = 0; diff != 0 && errors <= SYNC_THRESHOLD; errors++) {
+        diff &= diff - 1;           // Clear the lowest wrong bit
+    }
+    return errors;
+}
+
+void endReception() {
 
+#if RX_ENGINE == RX_CAPTURE
+    TA2CCTL0 = 0;
+    armCapture();
+    P2IE |= BIT4;
+#endif
+    P2IES &= ~BIT4;                 // Next frame starts on a rising edge
+    P2IFG &= ~BIT4;
     receiving = 0;
+#if RATE_ADAPT
+    if (link_wait == 1) {
+        setRate(link_next);         // Came due during this frame, the next one may start before the TA0 tick
+    }
+#endif
+}
+
+// Restarts the edge timestamps at the beginning of edge_times[]
+void armCapture() {
+
+    DMA_disableTransfers(DMA_CHANNEL_0);
+    DMA_setDstAddress(DMA_CHANNEL_0, (uint32_t)(uintptr_t)edge_times, DMA_DIRECTION_INCREMENT);
+    DMA_setTransferSize(DMA_CHANNEL_0, EDGE_BUFFER_SIZE);
+    DMA_enableTransfers(DMA_CHANNEL_0);
+}
+
+unsigned int capturedEdges() {
+
+    if (!(DMA0CTL & DMAEN)) {
+        return EDGE_BUFFER_SIZE;    // Buffer full, the channel stopped and reloaded DMA0SZ
+    }
+    return EDGE_BUFFER_SIZE - DMA0SZ;
+}
+
+#if RX_ENGINE == RX_SAMPLING
+char readSymbol() {
+
+    __bis_SR_register(LPM0_bits + GIE);       // CPU off, enable interrupts
+                                              //always wait for the right time to acquire data
+#if VOTING
+    // The tick comes a quarter sample after the last copy of this symbol, count the ones among them
+    unsigned int head = SAMPLE_RING - DMA0SZ;
+    unsigned int n, ones = 0;
+    for (n = 1; n <= OVERSAMPLING; n++) {
+        ones += samples[(head + SAMPLE_RING - n) % SAMPLE_RING] & BIT4;
+    }
+    return (ones >> 4) * 2 > OVERSAMPLING;
+#else
+#if SOFT_DECISION || PULSE_AMPLITUDE
+    ADC12CTL0 |= ADC12SC;                     // Light level of the same instant, for readSoftBit() and readGroup()
+#endif
+    return (P2IN & BIT4) >> 4;
+#endif
+}
+#else
+// Rebuilds the symbol whose middle is symbol_time from the edge timestamps. Every edge re-centers
+// symbol_time, so the run lengths are measured against the sender's own clock.
+char readSymbol() {
+
+    // We can only decide once an edge after the middle of the symbol, or the middle itself, is in the past
+    __disable_interrupt();
+    while (edge_read >= capturedEdges() && (int)(TA2R - symbol_time) < 0) {
+        __bis_SR_register(LPM0_bits + GIE);   // CPU off until the next CAPTURE_CHUNK
+        __disable_interrupt();
+    }
+    __enable_interrupt();
+
+    while (edge_read < capturedEdges() && (int)(edge_times[edge_read] - symbol_time) < 0) {
+        rx_level ^= 1;
+        symbol_time = edge_times[edge_read] + SYMBOL_COUNTS / 2;
+        edge_read++;
+    }
+
+    symbol_time += SYMBOL_COUNTS;
+    return rx_level;
+}
+#endif
+
+// Framing bits, and every bit when there is no block line code
+char readBit() {
+
+#if SYMBOLS_PER_BIT == 1
+    last_symbol = readSymbol();     // NRZI reference for the first 4B5B group
+    return last_symbol;
+#else
+    char first = readSymbol();
+    char second = readSymbol();
+
+    if (first == second) {
+        packet_error = 1;           // No edge in the middle of the bit, we slipped
+    }
+
+#if LINE_CODE == LINE_MANCHESTER
+    last_symbol = second;
+    return second;
+#else
+    char bit = (first == last_symbol);        // No edge at the start of a 1
+    last_symbol = second;
+    return bit;
+#endif
+#endif
 }
 
+// Header and block bits, taken out of the groups of the block line codes
+char readDataBit() {
 
-void retrieveData() {
+#if GROUP_BITS > 1
+    char bit;
+
+    if (group_fill == 0) {
+        readGroup();
+    }
+    bit = group & 1;
+    group >>= 1;
+    group_fill--;
+    return bit;
+#else
+    return readBit();
+#endif
+}
+
+// Reads the symbols of one group and looks its bits up, first symbol = bit 0 of the code
+void readGroup() {
+
+#if PULSE_AMPLITUDE
+    unsigned int sample, level = 0;
+
+    readSymbol();                   // Also started the ADC12 conversion
+    while (!(ADC12IFG & BIT0));
+    sample = ADC12MEM0;
+    while (level < PAM_LEVELS - 1 && sample > pam_threshold[level]) {
+        level++;
+    }
+    group = level ^ (level >> 1);   // The bits are the Gray code of the level
+    group_fill = GROUP_BITS;
+#elif GROUP_BITS > 1
+    unsigned int code = 0, pos;
+    unsigned char low, high;
+    char symbol;
+#if PULSE_POSITION
+    unsigned int pulses = 0;
+#endif
+
+    for (pos = 0; pos < GROUP_SYMBOLS; pos++) {
+        symbol = readSymbol();
+#if LINE_CODE == LINE_4B5B
+        code |= (unsigned int)(symbol != last_symbol) << pos;     // NRZI, a 1 is an edge
+        last_symbol = symbol;
+#elif PULSE_POSITION
+        if (symbol) {
+            code = pos;             // Slot of the pulse
+            pulses++;
+        }
+#else
+        code |= (unsigned int)symbol << pos;
+#endif
+    }
+
+#if LINE_CODE == LINE_4B5B
+    low = line_5b4b[code];
+    high = 0;
+#elif PULSE_POSITION
+    low = (pulses == 1) ? code : 0xFF;
+    high = 0;
+#else
+    low = line_6b5b[code & 0x3F];
+    high = line_4b3b[code >> 6];
+#endif
+    group = low | ((unsigned int)high << 5);
+    if (low == 0xFF || high == 0xFF) {
+        packet_error = 1;           // Not a code word (or not one pulse), a symbol was lost or made up
+        group = 0;
+    }
+    group_fill = GROUP_BITS;
+#endif
+}
+
+#if PULSE_AMPLITUDE
+// Averages the ADC12 reading of every light level over the training symbols, the thresholds go halfway between them
+void readTraining() {
+
+    unsigned int sums[PAM_LEVELS], pos;
+
+    for (pos = 0; pos < PAM_LEVELS; pos++) {
+        sums[pos] = 0;
+    }
+    for (pos = 0; pos < TRAINING_SYMBOLS; pos++) {
+        readSymbol();               // Also started the ADC12 conversion
+        while (!(ADC12IFG & BIT0));
+        sums[pos & (PAM_LEVELS - 1)] += ADC12MEM0;
+    }
+
+    for (pos = 0; pos < PAM_LEVELS - 1; pos++) {
+        if (sums[pos + 1] <= sums[pos]) {
+            packet_error = 1;       // The levels must go up, this was not a training sequence
+        }
+        pam_threshold[pos] = (sums[pos] + sums[pos + 1]) / (2 * TRAINING_ROUNDS);
+    }
+}
+#endif
+
+// Bytes are sent LSB first
+char readByte() {
+
+    char byte = 0;
+    unsigned int bit;
+    for (bit = 0; bit < 8; bit++) {
+        byte |= readCodeBit() << bit;
+    }
+    return byte;
+}
+
+// Output of the error correction, from the de-interleaved block once it is in
+char readCodeBit() {
+
+#if INTERLEAVE_ROWS > 1
+    if (deinterleaved) {
+        char bit = (buffer[HEADER_SIZE + (code_pos >> 3)] >> (code_pos & 7)) & 1;
+        code_pos++;
+        return bit;
+    }
+#endif
+    return readDataBit();
+}
+
+#if INTERLEAVE_ROWS > 1
+// Reads the whole block from the light, every bit goes straight to its place in the codewords
+void readInterleaved(unsigned int bits) {
+
+    unsigned int pos, index;
+
+    interleaverStart(bits);
+    for (pos = 0; pos < bits; pos++) {
+        index = interleaverNext();
+#if FEC == FEC_CONVOLUTIONAL
+        soft_samples[index] = readSoftBit();
+#else
+        if (readDataBit()) {
+            buffer[HEADER_SIZE + (index >> 3)] |= 1 << (index & 7);
+        }
+        else {
+            buffer[HEADER_SIZE + (index >> 3)] &= ~(1 << (index & 7));
+        }
+#endif
+    }
+    code_pos = 0;
+    deinterleaved = 1;
+}
+
+// Rows of il_columns bits, the last one may be short (same as the sender)
+void interleaverStart(unsigned int bits) {
+
+    il_bits = bits;
+    il_columns = (bits + INTERLEAVE_ROWS - 1) / INTERLEAVE_ROWS;
+    il_column = 0;
+    il_row = 0;
+    il_index = 0;
+}
+
+// Codeword position of the next bit on the air
+unsigned int interleaverNext() {
+
+    unsigned int index = il_index;
+
+    il_row++;
+    il_index += il_columns;
+    if (il_row == INTERLEAVE_ROWS || il_index >= il_bits) {
+        il_column++;                // Next column, from the top
+        il_row = 0;
+        il_index = il_column;
+    }
+    return index;
+}
+#endif
+
+// Every bit is xored with the received bits 6 and 7 before it, so a wrong bit only spoils 3 bits
+char descramble(char byte) {
+
+    unsigned int window = scrambler_state | ((unsigned int)(unsigned char)byte << 7);
+
+    scrambler_state = window >> 8;
+    return window ^ (window >> 1) ^ (window >> 7);
+}
+
+// Byte protected by the selected error correction, each codeword is fixed as soon as it is in
+char readCodedByte() {
+
+#if FEC == FEC_HAMMING
+    char low = hammingDecode(readByte());
+    char high = hammingDecode(readByte());
+    return low | (high << 4);
+#elif FEC == FEC_REED_SOLOMON
+    char byte = readByte();
+    rsFeed(byte);
+    return byte;
+#else
+    return readByte();
+#endif
+}
+
+// Payload length, opens the codeword
+void readHeader() {
 
-    temp = 0;
     unsigned int pos;
-    for (pos = 1; pos < BUFFER_SIZE * 8 + 1; pos++) {
+#if FEC == FEC_REED_SOLOMON
+    rsStart();
+#endif
+    for (pos = 0; pos < HEADER_SIZE; pos++) {
+#if FEC == FEC_REED_SOLOMON || FEC == FEC_CONVOLUTIONAL
+        char first = readByte();
+        char second = readByte();
+        char third = readByte();
+        buffer[pos] = (first & second) | (first & third) | (second & third);     // Bitwise majority of HEADER_COPIES
+
+#if FEC == FEC_REED_SOLOMON
+        rsFeed(buffer[pos]);
+#endif
+#else
+        buffer[pos] = readCodedByte();
+#endif
+    }
+}
+
+char forThisNode(unsigned char address) {
+
+    if (address == NODE_ADDRESS || address == ADDRESS_BROADCAST) {
+        return 1;
+    }
+    if (address >= ADDRESS_GROUP) {
+        return (NODE_GROUPS >> (address - ADDRESS_GROUP)) & 1;
+    }
+    return 0;
+}
+
+// Sleeps until the stop bit of a frame that isn't ours, the light isn't looked at meanwhile
+void skipFrame(unsigned int symbols) {
+
+#if RX_ENGINE == RX_SAMPLING
+    P2IE &= ~BIT4;                  // No re-phasing either
+    __disable_interrupt();
+    skip_symbols = symbols;
+    while (skip_symbols != 0) {
+        __bis_SR_register(LPM0_bits + GIE);   // TIMER0_A0 counts the symbols without waking us
+        __disable_interrupt();
+    }
+    __enable_interrupt();
+    P2IE |= BIT4;
+#else
+    unsigned int end = symbol_time + (symbols - 1) * SYMBOL_COUNTS;   // Middle of the last symbol before the stop bit
+    __disable_interrupt();
+    TA2CCR0 = end;
+    while ((int)(TA2R - end) < 0) {
+        __bis_SR_register(LPM0_bits + GIE);   // CPU off until TA2CCR0
+        __disable_interrupt();
+    }
+    __enable_interrupt();
+#endif
+}
+
+#if FEC == FEC_HAMMING
+char hammingDecode(char codeword) {
+
+    char nibble = hamming_decode[(unsigned char)codeword];
+
+    if (nibble & HAMMING_CORRECTED) {
+        fec_corrected++;
+    }
+    else if (nibble & HAMMING_FAILED) {
+        fec_uncorrectable++;
+        packet_error = 1;           // Two wrong bits, the crc would not match anyway
+    }
+    return nibble & 0x0F;
+}
+#endif
+
+#if FEC == FEC_CONVOLUTIONAL
+// Between frames, a long division is too slow to fit between two symbols
+void updateSoftScale() {
+
+    int span = adc_one - adc_zero;
+    if (span == 0) {
+        span = 1;
+    }
+    soft_scale = ((long)SOFT_MAX << 12) / span;
+}
+
+// Coded bit and how sure we are of it, from 0 (sure 0) to SOFT_MAX (sure 1)
+unsigned char readSoftBit() {
+
+#if SOFT_DECISION
+    char bit = readSymbol();                    // Also started the ADC12 conversion
+    int sample;
+    long level;
+
+    while (!(ADC12IFG & BIT0));
+    sample = ADC12MEM0;
+
+    // The comparator on P2.4 tells which level this sample belongs to, they drift with the distance
+    if (bit) {
+        adc_one += (sample - adc_one) / LEVEL_AVERAGING;
+    }
+    else {
+        adc_zero += (sample - adc_zero) / LEVEL_AVERAGING;
+    }
+
+    level = (long)(sample - adc_zero) * soft_scale;
+    if (level <= 0) {
+        return 0;
+    }
+    level >>= 12;
+    return level > SOFT_MAX ? SOFT_MAX : level;
+#else
+    return readDataBit() ? SOFT_MAX : 0;
+#endif
+}
+
+// Even parity of the bits of value
+char parity(unsigned int value) {
+
+    value ^= value >> 8;
+    value ^= value >> 4;
+    value ^= value >> 2;
+    value ^= value >> 1;
+    return value & 1;
+}
+
+// Coded bits of every encoder register (newest bit in bit 0), first one in bit 1
+void convInit() {
+
+    unsigned int reg;
+    for (reg = 0; reg < 2 * CONV_STATES; reg++) {
+        conv_output[reg] = (parity(reg & CONV_POLY_A) << 1) | parity(reg & CONV_POLY_B);
+    }
+}
+
+// Follows the survivor path back from state at step last, writes the bits of its first keep steps
+void traceBack(unsigned int last, unsigned int state, unsigned int length, unsigned int keep) {
+
+    unsigned int step = last + 1;
+    unsigned int row, older;
+
+    while (length-- > 0) {
+        step--;
+        row = step % (2 * TRACEBACK);
+        if (length < keep && step < conv_bits) {
+            conv_out[step >> 3] |= (state & 1) << (step & 7);
+        }
+        older = (conv_decisions[row][state >> 4] >> (state & 15)) & 1;
+        state = (state >> 1) | (older << (CONV_K - 2));
+    }
+}
+
+// Soft decision Viterbi decoding of soft_samples[] into nBytes of conv_out[]
+void viterbiDecode(unsigned int nBytes) {
+
+    unsigned int metric[2][CONV_STATES];
+    unsigned int *old_metric, *new_metric;
+    unsigned int steps, step, decided, state, row, word, best, lowest, m0, m1;
+    unsigned char expected;
+    unsigned char a, b;
+    unsigned char cost[4];
+
+    conv_bits = nBytes * 8;
+    steps = conv_bits + CONV_K - 1;         // The tail brings the encoder back to state 0
+    for (state = 0; state < nBytes; state++) {
+        conv_out[state] = 0;
+    }
+    for (state = 0; state < CONV_STATES; state++) {
+        metric[0][state] = CONV_UNREACHABLE;
+    }
+    metric[0][0] = 0;
+    decided = 0;
+    best = 0;
+
+    for (step = 0; step < steps; step++) {
+        old_metric = metric[step & 1];
+        new_metric = metric[(step & 1) ^ 1];
+        row = step % (2 * TRACEBACK);
+        for (word = 0; word < CONV_WORDS; word++) {
+            conv_decisions[row][word] = 0;
+        }
+
+        // Distance of the two samples to each pair of coded bits
+        a = soft_samples[2 * step];
+        b = soft_samples[2 * step + 1];
+        for (expected = 0; expected < 4; expected++) {
+            cost[expected] = ((expected & 2) ? SOFT_MAX - a : a) + ((expected & 1) ? SOFT_MAX - b : b);
+        }
+
+        // Add, compare, select: each state has two predecessors, which differ by the oldest bit
+        lowest = 0xFFFF;
+        for (state = 0; state < CONV_STATES; state++) {
+            m0 = old_metric[state >> 1] + cost[conv_output[state]];
+            m1 = old_metric[(state >> 1) | (CONV_STATES >> 1)] + cost[conv_output[state | CONV_STATES]];
+            if (m1 < m0) {
+                m0 = m1;
+                conv_decisions[row][state >> 4] |= 1 << (state & 15);
+            }
+            new_metric[state] = m0;
+            if (m0 < lowest) {
+                lowest = m0;
+                best = state;
+            }
+        }
+        for (state = 0; state < CONV_STATES; state++) {
+            new_metric[state] -= lowest;    // Keep the metrics small
+        }
+
+        // The oldest half of the window has merged into one path, it's final
+        if (step + 1 - decided == 2 * TRACEBACK) {
+            traceBack(step, best, 2 * TRACEBACK, TRACEBACK);
+            decided += TRACEBACK;
+        }
+    }
+
+    traceBack(steps - 1, 0, steps - decided, steps - decided);
 
-        temp |= packet[pos] << (pos-1) % 8;
-        if (pos != 0 && pos % 8 == 0) {
-            buffer[((pos-1) / 8)] = temp;
-            temp = 0;
+    // Count the coded bits the decoder overruled, for the debugger
+    state = 0;
+    for (step = 0; step < steps; step++) {
+        state = (state << 1) & (2 * CONV_STATES - 1);
+        if (step < conv_bits) {
+            state |= (conv_out[step >> 3] >> (step & 7)) & 1;
         }
+        expected = conv_output[state];
+        fec_corrected += ((expected >> 1) != (soft_samples[2 * step] > SOFT_MAX / 2));
+        fec_corrected += ((expected & 1) != (soft_samples[2 * step + 1] > SOFT_MAX / 2));
     }
 }
+#endif
+
+#if FEC == FEC_REED_SOLOMON
+// GF(256) arithmetic, primitive polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11D)
+unsigned char gfMul(unsigned char a, unsigned char b) {
+
+    if (a == 0 || b == 0) {
+        return 0;
+    }
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+unsigned char gfDiv(unsigned char a, unsigned char b) {
+
+    if (a == 0) {
+        return 0;
+    }
+    return gf_exp[gf_log[a] + 255 - gf_log[b]];
+}
+
+// Opens a codeword
+void rsStart() {
+
+    unsigned int j;
+    for (j = 0; j < RS_PARITY; j++) {
+        rs_syndrome[j] = 0;
+    }
+    rs_length = 0;
+}
+
+// Keeps a received byte of the codeword and updates the syndromes with it (Horner's rule).
+// Syndrome j is multiplied by a^j, so the product is one step in the tables, without gfMul().
+void rsFeed(unsigned char byte) {
+
+    unsigned int j;
+    unsigned char syndrome;
+
+    for (j = 0; j < RS_PARITY; j++) {
+        syndrome = rs_syndrome[j];
+        if (syndrome != 0) {
+            syndrome = gf_exp[gf_log[syndrome] + j];
+        }
+        rs_syndrome[j] = syndrome ^ byte;
+    }
+    rs_block[rs_length++] = byte;
+}
+
+// Fixes rs_block in place (Berlekamp-Massey, Chien search, Forney). Returns 0 if there are too many errors.
+char rsDecode() {
+
+    unsigned char lambda[RS_PARITY + 1], previous[RS_PARITY + 1], saved[RS_PARITY + 1], omega[RS_PARITY];
+    unsigned char discrepancy, last_discrepancy, coefficient, value, numerator, denominator;
+    unsigned int term[RS_PARITY / 2 + 1];  // Logs of lambda[k] * x_inv^k at the byte being tried
+    unsigned int j, k, order, shift, pos, found, log_x_inv, log_x_inv2;
 
+    discrepancy = 0;
+    for (j = 0; j < RS_PARITY; j++) {
+        discrepancy |= rs_syndrome[j];
+    }
+    if (discrepancy == 0) {
+        return 1;                   // Nothing to fix, the common case
+    }
+
+    // Error locator
+    for (j = 0; j <= RS_PARITY; j++) {
+        lambda[j] = 0;
+        previous[j] = 0;
+    }
+    lambda[0] = 1;
+    previous[0] = 1;
+    order = 0;
+    shift = 1;
+    last_discrepancy = 1;
+
+    for (k = 0; k < RS_PARITY; k++) {
+        discrepancy = rs_syndrome[k];
+        for (j = 1; j <= order; j++) {
+            discrepancy ^= gfMul(lambda[j], rs_syndrome[k - j]);
+        }
+        if (discrepancy == 0) {
+            shift++;
+            continue;
+        }
+        coefficient = gfDiv(discrepancy, last_discrepancy);
+        for (j = 0; j <= RS_PARITY; j++) {
+            saved[j] = lambda[j];
+        }
+        for (j = shift; j <= RS_PARITY; j++) {
+            lambda[j] ^= gfMul(coefficient, previous[j - shift]);
+        }
+        if (2 * order <= k) {
+            order = k + 1 - order;
+            for (j = 0; j <= RS_PARITY; j++) {
+                previous[j] = saved[j];
+            }
+            last_discrepancy = discrepancy;
+            shift = 1;
+        }
+        else {
+            shift++;
+        }
+    }
+    if (order > RS_PARITY / 2) {
+        return 0;
+    }
+
+    // Error evaluator
+    for (j = 0; j < RS_PARITY; j++) {
+        omega[j] = 0;
+        for (k = 0; k <= j && k <= order; k++) {
+            omega[j] ^= gfMul(rs_syndrome[j - k], lambda[k]);
+        }
+    }
+
+    // Roots of the locator give the positions, Forney gives the values. The first byte has degree
+    // rs_length - 1, x_inv = a^-(rs_length - 1); every next byte multiplies term k by a^k.
+    log_x_inv = 255 - (rs_length - 1);
+    for (k = 1; k <= order; k++) {
+        term[k] = lambda[k] == 0 ? 255 : (gf_log[lambda[k]] + k * log_x_inv) % 255;     // 255: no term, logs stop at 254
+    }
+    found = 0;
+    for (pos = 0; pos < rs_length; pos++) {
+        value = lambda[0];
+        for (k = 1; k <= order; k++) {
+            if (term[k] != 255) {
+                value ^= gf_exp[term[k]];
+                term[k] += k;
+                if (term[k] >= 255) {
+                    term[k] -= 255;
+                }
+            }
+        }
+        if (value != 0) {
+            continue;
+        }
+
+        j = rs_length - 1 - pos;                    // Degree of this byte in the codeword
+        log_x_inv = 255 - j;
+        log_x_inv2 = 2 * log_x_inv;
+        if (log_x_inv2 >= 255) {
+            log_x_inv2 -= 255;
+        }
+        numerator = 0;
+        for (k = RS_PARITY; k-- > 0;) {
+            if (numerator != 0) {
+                numerator = gf_exp[gf_log[numerator] + log_x_inv];
+            }
+            numerator ^= omega[k];
+        }
+        denominator = 0;
+        for (k = (order + 1) | 1; k > 1;) {         // Odd terms make the formal derivative
+            k -= 2;
+            if (denominator != 0) {
+                denominator = gf_exp[gf_log[denominator] + log_x_inv2];
+            }
+            denominator ^= lambda[k];
+        }
+        if (denominator == 0) {
+            return 0;
+        }
+        rs_block[pos] ^= gfMul(gf_exp[j], gfDiv(numerator, denominator));
+        found++;
+    }
+
+    if (found != order) {
+        return 0;                   // Locator roots outside the codeword, can't be trusted
+    }
+    fec_corrected += found;
+    return 1;
+}
+#endif
+
+
+#if CRC_TYPE == CRC_32
 void crcInit(void)
 {
     crc remainder;
@@ -256,7 +1757,7 @@ void crcInit(void)
         /*
          * Start with the dividend followed by zeros.
          */
-        remainder = dividend << (WIDTH - 8);
+        remainder = (crc)dividend << (WIDTH - 8);
 
         /*
          * Perform modulo-2 division, a bit at a time.
@@ -284,34 +1785,30 @@ void crcInit(void)
     }
 
 }   /* crcInit() */
+#endif
 
-
-void verifyData(char const message[])
+// CRC of a frame buffer, with the same settings as the sender
+crc calculateChecksum(char const message[], int nBytes)
 {
-
-    // Verify start and stop bits
-    if (packet[0] != START_BIT || packet[PACKET_SIZE - 1] != STOP_BIT) {
-
-        packet_error = 1;
-        return;
-    }
-
-    checksum = 0;
-
-    // Find the checksum from the received packet
-    for(i = 0; i < sizeof(crc) * 8; i++) {
-
-        checksum |= packet[BUFFER_SIZE*8 + 1 + i] << i % (sizeof(crc) * 8);
-    }
-
-    char data;
-    crc remainder = 0;
+#if CRC_TYPE == CRC_16
+    CRC_setSeed(CRC_BASE, CRC_SEED);
+    DMA_setSrcAddress(DMA_CHANNEL_2, (uint32_t)(uintptr_t)message, DMA_DIRECTION_INCREMENT);
+    DMA_setTransferSize(DMA_CHANNEL_2, nBytes);
+    DMA_enableTransfers(DMA_CHANNEL_2);
+    DMA_startTransfer(DMA_CHANNEL_2);                   // The CPU is held while the block is copied
+    while (DMA_getInterruptStatus(DMA_CHANNEL_2) == DMA_INT_INACTIVE);
+    DMA_clearInterrupt(DMA_CHANNEL_2);
+
+    return CRC_getResult(CRC_BASE);
+#else
+    unsigned char data;
+    crc remainder = ~(crc)0;                            // CRC-32/MPEG-2: non-reflected, all ones seed
 
     /*
      * Divide the message by the polynomial, a byte at a time.
      */
     int byte;
-    for (byte = 0; byte < BUFFER_SIZE; ++byte) {
+    for (byte = 0; byte < nBytes; ++byte) {
         data = message[byte] ^ (remainder >> (WIDTH - 8));
         remainder = crcTable[data] ^ (remainder << 8);
     }
@@ -319,16 +1816,14 @@ void verifyData(char const message[])
     /*
      * The final remainder is the CRC.
      */
-    if (remainder != checksum){
-        packet_error = 1;
-    }
-
+    return (remainder);
+#endif
 }
 
 
 void sendToComputer() {
 
-    for (i = 0; i < BUFFER_SIZE; i++) {
+    for (i = HEADER_SIZE; i < HEADER_SIZE + frame_length; i++) {
         while(UCA1STAT & UCBUSY);
         UCA1TXBUF = buffer[i];
     }
@@ -341,3 +1836,317 @@ void printError() {
             UCA1TXBUF = error[i];
         }
 }
+
+#if ARQ
+// Gives the frame to the computer if it is the next one, or keeps it until the missing ones before it
+// come again. Every good frame is acked, repeats of delivered frames too since their ack was lost.
+void arqReceive() {
+
+    unsigned char seq = buffer[HEADER_SIZE];
+    unsigned char offset = seq - arq_base;
+    unsigned char slot;
+
+    if (offset == 0) {
+        arqDeliver(buffer);
+        arq_base++;
+        while (arq_held & (1 << (arq_base % ARQ_WINDOW))) {
+            slot = arq_base % ARQ_WINDOW;
+            arqDeliver(arq_frames[slot]);
+            arq_held &= ~(1 << slot);
+            arq_base++;
+        }
+    }
+    else if (offset < ARQ_WINDOW) {
+        slot = seq % ARQ_WINDOW;
+        if (arq_held & (1 << slot)) {
+            arq_duplicates++;
+        }
+        else {
+            for (i = 0; i < HEADER_SIZE + frame_length; i++) {
+                arq_frames[slot][i] = buffer[i];
+            }
+            arq_held |= 1 << slot;
+        }
+    }
+    else {
+        arq_duplicates++;           // Behind arq_base, already with the computer
+    }
+
+    arqSendAck();
+}
+
+void arqDeliver(char const *frame) {
+
+    unsigned int length = HEADER_SIZE + (unsigned char)frame[0];
+
+    for (i = HEADER_SIZE + ARQ_HEADER; i < length; i++) {
+        while(UCA1STAT & UCBUSY);
+        UCA1TXBUF = frame[i];
+    }
+    arq_delivered++;
+}
+
+// Next expected number, the frames held after it (bit j = arq_base + j) and the frame that made us ack
+void arqSendAck() {
+
+    unsigned char bits = 0;
+    unsigned int offset;
+
+    for (offset = 1; offset < ARQ_WINDOW; offset++) {
+        if (arq_held & (1 << ((arq_base + offset) % ARQ_WINDOW))) {
+            bits |= 1 << offset;
+        }
+    }
+
+    __disable_interrupt();
+    arq_ack_next[0] = ARQ_ACK_MARK;
+    arq_ack_next[1] = arq_base;
+    arq_ack_next[2] = bits;
+    arq_ack_next[3] = buffer[HEADER_SIZE];
+    arq_ack_next[4] = ARQ_ACK_MARK ^ arq_base ^ bits ^ arq_ack_next[3];
+    arq_ack_due = 1;
+    UCA0IE |= UCTXIE;               // TXIFG is set while the wire is idle, the interrupt starts the ack
+    __enable_interrupt();
+}
+#endif
+
+#if RATE_ADAPT
+// Link frame from the sender. It sends LINK_COPIES of them at the old rate, so the rate they name
+// is only taken after the last one, or once the copies left would be over when that one is lost.
+void linkReceive() {
+
+    unsigned char rate = buffer[HEADER_SIZE];
+    unsigned char left = buffer[HEADER_SIZE + 1];
+
+    rate_silence = 0;
+    if (frame_length != LINK_SIZE || rate > RATE_STEPS) {
+        return;
+    }
+    if (left != 0) {
+        link_next = rate;
+        link_wait = left * LINK_SYMBOLS;
+    }
+    else if (rate != link_rate) {
+        setRate(rate);
+    }
+    else {
+        link_wait = 0;
+    }
+}
+
+// Every symbol timing follows SYMBOL_PERIOD, only the registers loaded once need it again
+void setRate(unsigned char rate) {
+
+    link_rate = rate;
+    pll_integrator = 0;             // It was in cycles of the old period
+    TA0CCR0 = SYMBOL_PERIOD - 1;
+#if VOTING
+    TA1CCR0 = SAMPLE_PERIOD - 1;
+#endif
+    rate_silence = 0;
+    rate_silence_limit = RATE_SILENCE_MS * (CLOCK_FREQUENCY / 1000ul) / SYMBOL_PERIOD;
+    link_wait = 0;
+}
+#endif
+
+#if FOUNTAIN
+// Takes the coded symbol of a good frame and peels whatever it unlocks. The block goes to the computer
+// as soon as every buffer is in, whichever frames were lost on the way.
+void fountainReceive() {
+
+    char *symbol = buffer + HEADER_SIZE + FOUNTAIN_HEADER;
+    unsigned char block = buffer[HEADER_SIZE];
+    unsigned int id = (unsigned char)buffer[HEADER_SIZE + 1] | ((unsigned int)(unsigned char)buffer[HEADER_SIZE + 2] << 8);
+    unsigned int mask, source, slot;
+
+    if (frame_length != FOUNTAIN_HEADER + FOUNTAIN_SYMBOL_SIZE) {
+        return;                     // Not a fountain frame
+    }
+    if (!fountain_started || block != fountain_block) {
+        if (fountain_started && fountain_decoded != FOUNTAIN_ALL) {
+            fountain_lost++;
+        }
+        fountainStart(block);
+    }
+    if (fountain_decoded == FOUNTAIN_ALL) {
+        return;                     // Already with the computer, the sender is still repeating it
+    }
+
+    // Take out the buffers we already have
+    mask = fountainNeighbours(id);
+    for (source = 0; source < FOUNTAIN_K; source++) {
+        if (mask & fountain_decoded & (1u << source)) {
+            xorSymbol(symbol, fountain_source[source]);
+        }
+    }
+    mask &= ~fountain_decoded;
+
+    if (mask == 0) {
+        return;                     // Nothing new in it
+    }
+    if (mask & (mask - 1)) {
+        for (slot = 0; slot < FOUNTAIN_PENDING && fountain_mask[slot]; slot++);
+        if (slot < FOUNTAIN_PENDING) {
+            copySymbol(fountain_pending[slot], symbol);
+            fountain_mask[slot] = mask;
+        }
+        return;                     // Waits for the buffers it is made of (dropped when there is no room)
+    }
+
+    for (source = 0; !(mask & (1u << source)); source++);
+    copySymbol(fountain_source[source], symbol);
+    fountain_decoded |= mask;
+    fountainPeel();
+
+    if (fountain_decoded == FOUNTAIN_ALL) {
+        sendBlock();
+    }
+}
+
+// New buffers are taken out of the pending symbols, the ones left with a single buffer give it to us
+void fountainPeel() {
+
+    unsigned int slot, source, mask;
+    char progress;
+
+    do {
+        progress = 0;
+        for (slot = 0; slot < FOUNTAIN_PENDING; slot++) {
+            mask = fountain_mask[slot];
+            if (mask == 0) {
+                continue;
+            }
+            for (source = 0; source < FOUNTAIN_K; source++) {
+                if (mask & fountain_decoded & (1u << source)) {
+                    xorSymbol(fountain_pending[slot], fountain_source[source]);
+                }
+            }
+            mask &= ~fountain_decoded;
+            if (mask != 0 && !(mask & (mask - 1))) {
+                for (source = 0; !(mask & (1u << source)); source++);
+                copySymbol(fountain_source[source], fountain_pending[slot]);
+                fountain_decoded |= mask;
+                mask = 0;
+                progress = 1;
+            }
+            fountain_mask[slot] = mask;
+        }
+    } while (progress);
+}
+
+void fountainStart(unsigned char block) {
+
+    unsigned int slot;
+
+    fountain_block = block;
+    fountain_started = 1;
+    fountain_decoded = 0;
+    for (slot = 0; slot < FOUNTAIN_PENDING; slot++) {
+        fountain_mask[slot] = 0;
+    }
+}
+
+void xorSymbol(char *symbol, char const *source) {
+
+    unsigned int pos;
+    for (pos = 0; pos < FOUNTAIN_SYMBOL_SIZE; pos++) {
+        symbol[pos] ^= source[pos];
+    }
+}
+
+void copySymbol(char *symbol, char const *source) {
+
+    unsigned int pos;
+    for (pos = 0; pos < FOUNTAIN_SYMBOL_SIZE; pos++) {
+        symbol[pos] = source[pos];
+    }
+}
+
+// Every buffer of the block, in order, without the empty ones that completed the last block
+void sendBlock() {
+
+    unsigned int source, length;
+
+    for (source = 0; source < FOUNTAIN_K; source++) {
+        length = (unsigned char)fountain_source[source][0];
+        if (length > FOUNTAIN_SYMBOL_SIZE - HEADER_SIZE) {
+            length = 0;
+        }
+        for (i = HEADER_SIZE; i < HEADER_SIZE + length; i++) {
+            while(UCA1STAT & UCBUSY);
+            UCA1TXBUF = fountain_source[source][i];
+        }
+    }
+}
+
+// Robust soliton degree distribution (Luby), the same table as the sender
+void fountainInit() {
+
+    double spread = FOUNTAIN_C * log(FOUNTAIN_K / FOUNTAIN_DELTA) * sqrt(FOUNTAIN_K);
+    double total = 0, sum = 0;
+    unsigned int spike = (unsigned int)(FOUNTAIN_K / spread + 0.5);
+    unsigned int degree;
+
+    if (spike < 1) {
+        spike = 1;
+    }
+    if (spike > FOUNTAIN_K) {
+        spike = FOUNTAIN_K;
+    }
+    for (degree = 1; degree <= FOUNTAIN_K; degree++) {
+        total += solitonWeight(degree, spread, spike);
+    }
+    for (degree = 1; degree <= FOUNTAIN_K; degree++) {
+        sum += solitonWeight(degree, spread, spike);
+        fountain_cdf[degree - 1] = (unsigned int)(sum / total * 65535.0 + 0.5);
+    }
+    fountain_cdf[FOUNTAIN_K - 1] = 65535;
+}
+
+double solitonWeight(unsigned int degree, double spread, unsigned int spike) {
+
+    double weight = (degree == 1) ? 1.0 / FOUNTAIN_K : 1.0 / (degree * (degree - 1.0));
+
+    if (degree < spike) {
+        weight += spread / (degree * (double)FOUNTAIN_K);
+    }
+    else if (degree == spike) {
+        weight += spread * log(spread / FOUNTAIN_DELTA) / FOUNTAIN_K;
+    }
+    return weight;
+}
+
+// xorshift16, never gives 0 from a state other than 0
+unsigned int fountainRandom() {
+
+    fountain_random ^= fountain_random << 7;
+    fountain_random ^= fountain_random >> 9;
+    fountain_random ^= fountain_random << 8;
+    return fountain_random;
+}
+
+// Buffers combined in coded symbol id (bit j = buffer j of the block), the same on both sides
+unsigned int fountainNeighbours(unsigned int id) {
+
+    unsigned int mask = 0, degree = 1, index, draw;
+
+    if (id < FOUNTAIN_K) {
+        return 1u << id;            // The first ones go out as they are, nothing to decode without losses
+    }
+
+    fountain_random = id * 0x9E37u;             // Odd, consecutive ids start far apart
+    fountainRandom();
+    draw = fountainRandom();
+    while (degree < FOUNTAIN_K && fountain_cdf[degree - 1] < draw) {
+        degree++;
+    }
+    while (degree--) {
+        index = fountainRandom() % FOUNTAIN_K;
+        while (mask & (1u << index)) {
+            index = (index + 1) % FOUNTAIN_K;
+        }
+        mask |= 1u << index;
+    }
+    return mask;
+}
+#endif
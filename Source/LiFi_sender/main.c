@@ -4,32 +4,345 @@
 
 // ----------- CLOCK ----------------------------------------
 #define CLOCK_FREQUENCY  24000000        // (hertz)
-#define TIMER_COUNTER    480           // Number of clock cycles before every timer interrupt
-                                        // Here it also represents the baud rate of li-fi transmission (CLOCK_SPEED / TIMER_COUNTER)
-                                        // Can't go under 8000 for now
+#define TIMER_COUNTER    480           // Number of clock cycles in one bit (one symbol with PAM)
+                                        // Here it also represents the bit rate of li-fi transmission (CLOCK_SPEED / TIMER_COUNTER)
+                                        // With RATE_ADAPT it is only the start-up (and slowest) rate
+                                        // Can't go under 8000 for now with TX_SOFTWARE
+                                        // TX_DMA only needs the few cycles of one DMA transfer per symbol
+#define SYMBOL_PERIOD    ((TIMER_COUNTER * GROUP_BITS / GROUP_SYMBOLS / LEVEL_BITS) >> LINK_RATE)      // Number of clock cycles in one symbol (Don't change this)
+// ----------------------------------------------------------
+// ----------- SELECT LINE CODE -----------------------------
+#define LINE_NRZ                0       // One symbol per bit, LED on for a 1
+#define LINE_MANCHESTER         1       // 0 = on/off, 1 = off/on (IEEE 802.3), an edge in the middle of every bit
+#define LINE_DIFF_MANCHESTER    2       // Edge in the middle of every bit, an extra edge at the start of a 0
+#define LINE_4B5B               3       // Every 4 bits sent as 5 NRZI symbols, an edge at least every 4 symbols
+#define LINE_8B10B              4       // Every byte sent as 10 symbols, DC balanced (running disparity), an edge at least every 5 symbols
+#define LINE_4PPM               5       // Every 2 bits sent as one pulse in 4 slots, the LED is on a quarter of the time
+#define LINE_16PPM              6       // Every 4 bits sent as one pulse in 16 slots, slots are TIMER_COUNTER / 4 (use TX_DMA and RX_CAPTURE)
+#define LINE_4PAM               7       // Every 2 bits sent as one of 4 light levels, TIMER_COUNTER is then one symbol (TX_DMA and RX_SAMPLING only)
+#define LINE_8PAM               8       // Every 3 bits sent as one of 8 light levels
+#define LINE_CODE               LINE_NRZ
+
+#define PULSE_POSITION     (LINE_CODE == LINE_4PPM || LINE_CODE == LINE_16PPM)      // (Don't change this)
+#define PULSE_AMPLITUDE    (LINE_CODE == LINE_4PAM || LINE_CODE == LINE_8PAM)       // (Don't change this)
+
+#if LINE_CODE == LINE_MANCHESTER || LINE_CODE == LINE_DIFF_MANCHESTER
+#define SYMBOLS_PER_BIT    2
+#else
+#define SYMBOLS_PER_BIT    1            // The block codes and PPM only cover the header and the block, the framing bits stay NRZ
+#endif
+
+#if LINE_CODE == LINE_4B5B
+#define GROUP_BITS       4
+#define GROUP_SYMBOLS    5
+#elif LINE_CODE == LINE_8B10B
+#define GROUP_BITS       8
+#define GROUP_SYMBOLS    10
+#elif LINE_CODE == LINE_4PPM
+#define GROUP_BITS       2
+#define GROUP_SYMBOLS    4
+#elif LINE_CODE == LINE_16PPM
+#define GROUP_BITS       4
+#define GROUP_SYMBOLS    16
+#elif LINE_CODE == LINE_4PAM
+#define GROUP_BITS       2
+#define GROUP_SYMBOLS    1
+#elif LINE_CODE == LINE_8PAM
+#define GROUP_BITS       3
+#define GROUP_SYMBOLS    1
+#else
+#define GROUP_BITS       1
+#define GROUP_SYMBOLS    SYMBOLS_PER_BIT
+#endif
+
+#if PULSE_AMPLITUDE
+#define LEVEL_BITS       GROUP_BITS     // Bits in the amplitude of one symbol, the symbol clock stays at TIMER_COUNTER
+#define PAM_LEVELS       (1 << GROUP_BITS)
+#define TRAINING_ROUNDS  4              // Every level is sent this many times after the sync word to calibrate the receiver (at most 4)
+#define TRAINING_SYMBOLS (PAM_LEVELS * TRAINING_ROUNDS)
+#else
+#define LEVEL_BITS       1
+#define TRAINING_SYMBOLS 0
+#endif
+// ----------------------------------------------------------
+// ----------- SELECT TRANSMIT ENGINE -----------------------
+#define TX_SOFTWARE    0                // P2OUT is written by the CPU on every TIMER0_A0 tick
+#define TX_TIMER       1                // Edges are placed by the TA1.1 compare output on P2.0
+#define TX_DMA         2                // packet[] is copied to P2OUT by DMA0 on every TA0CCR0 compare
+#define TX_ENGINE      TX_DMA
+#define TX_RETRIES     2                // TX_TIMER: a frame cut short by a late TA1.1 compare goes again this many times
+
+#if PULSE_AMPLITUDE && TX_ENGINE == TX_TIMER
+#error "The TA1.1 output only has two levels, PAM needs TX_DMA (or TX_SOFTWARE) to set the TB0.2 duty cycle"
+#endif
+// ----------------------------------------------------------
+// ----------- SYMBOLS --------------------------------------
+#if PULSE_AMPLITUDE
+#define PAM_PWM_PERIOD 42                           // (cycles) TB0.2 PWM on P7.4, smoothed by the RC stage of the LED driver
+#define LEVEL(level)   (char)((level) * PAM_PWM_PERIOD / (PAM_LEVELS - 1))      // TB0CCR2 duty of a light level
+#define SYMBOL(bit)    LEVEL((bit) * (PAM_LEVELS - 1))                          // Framing bits are off or full light
+#elif TX_ENGINE == TX_DMA
+#define SYMBOL(bit)    (char)(~(0xFE | (bit)))     // P2OUT image of a bit (LED is on when P2.0 is low)
+#else
+#define SYMBOL(bit)    (bit)
+#endif
 // ----------------------------------------------------------
 // ----------- UART TRANSMISSION ----------------------------
 #define UART_BAUD_RATE      115200      // (bit/s) - the communication with the computer
+#define UART_ECHO           1           // Send every byte back to the computer
+#define UART_RX_DMA         1           // Bytes are moved to uart_ring by DMA1 instead of USCI_A1_ISR
+#define UART_RING_SIZE      128         // (bytes) Must hold what the computer sends during one frame, more is dropped
+#define UART_POLL_COUNTER   32          // Number of ACLK cycles between two looks at the UART (~1 ms)
+#define UART_IDLE_POLLS     2           // A partial buffer is sent after that many polls without a new byte
+// ----------------------------------------------------------
+// ----------- SELECT FOUNTAIN CODE (same as the receiver) --
+#define FOUNTAIN         0              // 1 = one-way bulk transfer, frames carry LT coded symbols of FOUNTAIN_K buffers
+#define FOUNTAIN_K       16             // Buffers (source symbols) in one block (16 max)
+#define FOUNTAIN_SYMBOLS (2 * FOUNTAIN_K)       // Coded symbols of a block sent before the next full block, the last block keeps going
+#define FOUNTAIN_C       0.1            // Robust soliton degree distribution constants
+#define FOUNTAIN_DELTA   0.5
+#define FOUNTAIN_HEADER  3              // (bytes) block number and symbol id, in front of the coded symbol (Don't change this)
+#define FOUNTAIN_SYMBOL_SIZE (BUFFER_SIZE - FOUNTAIN_HEADER)    // (bytes) a whole buffer, length included (Don't change this)
+// ----------------------------------------------------------
+// ----------- SELECT ARQ (same as the receiver) ------------
+#define ARQ              0              // 1 = selective repeat, frames are numbered and the receiver acks them (not with FOUNTAIN)
+#define ARQ_WINDOW       8              // Frames kept until they are acked (2, 4 or 8, the ack bitmap is one byte)
+#define ARQ_BAUD_RATE    9600           // (bit/s) return channel on UCA0, P3.4 = UCA0RXD from the receiver's P3.3
+#define ARQ_TIMEOUT      20             // UART polls (~1 ms) without an ack before the unacked frames go again
+#define ARQ_HEADER       (ARQ ? 1 : 0)  // (bytes) sequence number, in front of the data (Don't change this)
+#define ARQ_ACK_MARK     0xA5           // First byte of an ack, then next expected number, bitmap, number of the acked frame, check
+#define ARQ_ACK_SIZE     5              // (bytes) (Don't change this)
+
+#if ARQ && FOUNTAIN
+#error "FOUNTAIN is one-way and ARQ resends lost frames, select one"
+#endif
+// ----------------------------------------------------------
+// ----------- SELECT RATE ADAPTATION (same as the receiver)
+#define RATE_ADAPT        0             // 1 = the rate follows the resends, link frames move both boards in steps of x2 (needs ARQ and TX_TIMER or TX_DMA)
+#define RATE_STEPS        1             // Rates above TIMER_COUNTER: / 2, / 4 ... (the receiver refuses to build with one it can't read)
+#define RATE_WINDOW       32            // Frames sent between two decisions
+#define RATE_UP_RESENDS   0             // At most that many resends in a window, the next rate is tried
+#define RATE_DOWN_RESENDS 8             // That many in a window, back one rate
+#define RATE_HOLD         8             // Clean windows before the rate that failed is tried again
+#define RATE_FALLBACK     4             // ARQ timeouts in a row that send the link back to TIMER_COUNTER
+#define RATE_IDLE_POLLS   100           // UART polls (~1 ms) without a frame that send it back too, below the receiver's RATE_SILENCE_MS
+#define LINK_COPIES       3             // Link frames per change, sent at the old rate
+#define LINK_SIZE         2             // (bytes) payload of a link frame: the next rate, then the copies still to come (Don't change this)
+#define LINK_SYNC_WORD    ((sync_word)~SYNC_WORD)      // Link frames start with the inverted sync word (Don't change this)
+#if RATE_ADAPT
+#define LINK_RATE         link_rate     // (Don't change this)
+#else
+#define LINK_RATE         0
+#endif
+
+#if RATE_ADAPT && !ARQ
+#error "RATE_ADAPT follows the ARQ resends, it needs ARQ"
+#endif
+#if RATE_ADAPT && TX_ENGINE == TX_SOFTWARE
+#error "RATE_ADAPT needs TX_TIMER or TX_DMA, TX_SOFTWARE can't keep up with the faster rates"
+#endif
+// ----------------------------------------------------------
+// ----------- SELECT TDMA ----------------------------------
+#define TDMA             0              // 1 = several senders share the light, each one only starts frames in its own slot (not with ARQ)
+#define TDMA_MASTER      0              // 1 on exactly one sender, its beacon starts every superframe
+#define TDMA_SLOT        0              // Slot of this sender (0 to TDMA_SLOTS - 1)
+#define TDMA_SLOTS       4              // Slots in a superframe
+#define TDMA_GUARD_POLLS 1              // UART polls (~1 ms) left free in every slot, on top of the longest frame and the ACLK drift
+#define TDMA_BAUD_RATE   9600           // (bit/s) beacon line, P3.3 = UCA0TXD of the master to P3.4 = UCA0RXD of the others
+#define TDMA_BEACON      0xB5           // Beacon byte
+#define TDMA_BEACON_POLLS (10 * 32768 / TDMA_BAUD_RATE / UART_POLL_COUNTER)     // Polls the beacon spends on the line (Don't change this)
+#define TDMA_FRAME_POLLS ((PACKET_SIZE * (unsigned long)(TIMER_COUNTER * GROUP_BITS / GROUP_SYMBOLS / LEVEL_BITS) - 1) \
+                          / (CLOCK_FREQUENCY / 32768 * UART_POLL_COUNTER) + 1)  // Polls the longest frame is on the air (Don't change this)
+#define TDMA_DRIFT_POLLS ((TDMA_SLOTS * TDMA_FRAME_POLLS + 24) / 25)            // ACLKs (REFO) up to 2 % apart each way, for a superframe (Don't change this)
+#define TDMA_SLOT_POLLS  (TDMA_FRAME_POLLS + TDMA_DRIFT_POLLS + TDMA_GUARD_POLLS)   // (Don't change this)
+// The beacon goes over a wire and not over the light, so a sender doesn't need the photodiode of CSMA
+// on P2.4 and doesn't have to tell the beacon from the frames of the others. Wire P3.3 of the master
+// to P3.4 of every other sender, with a common ground.
+
+#if TDMA && ARQ
+#error "TDMA and ARQ both use UCA0, the beacons would be read as ack bytes"
+#endif
+#if TDMA && TDMA_SLOT >= TDMA_SLOTS
+#error "TDMA_SLOT is past the last slot of the superframe"
+#endif
+// ----------------------------------------------------------
+// ----------- SELECT CARRIER SENSE -------------------------
+#define CSMA              0             // 1 = look at the light on P2.4 (photodiode, as on the receiver) before every frame, back off while it is busy
+                                        // Only edges are heard, so the line code must bound how long the LED stays off in a frame
+#define CSMA_MIN_WINDOW   4             // Backoff drawn in 1 to that many polls, doubled after every busy look
+#define CSMA_MAX_WINDOW   64
+
+#if LINE_CODE == LINE_MANCHESTER || LINE_CODE == LINE_DIFF_MANCHESTER
+#define LINE_DARK_RUN     2             // Longest the LED stays off inside a frame (symbols, framing bits included)
+#elif LINE_CODE == LINE_4B5B
+#define LINE_DARK_RUN     4
+#elif LINE_CODE == LINE_8B10B
+#define LINE_DARK_RUN     5
+#elif LINE_CODE == LINE_4PPM
+#define LINE_DARK_RUN     6
+#elif LINE_CODE == LINE_16PPM
+#define LINE_DARK_RUN     30
+#else
+#define LINE_DARK_RUN     0             // NRZ and PAM can stay dark for a whole frame of 0s
+#endif
+#if CSMA && LINE_DARK_RUN == 0
+#error "CSMA can't tell a frame of 0s from idle light with NRZ or PAM, select a line code with bounded dark runs"
+#endif
+#define CSMA_LISTEN_POLLS (LINE_DARK_RUN * (TIMER_COUNTER * GROUP_BITS / GROUP_SYMBOLS / LEVEL_BITS) / (CLOCK_FREQUENCY / 32768 * UART_POLL_COUNTER) + 2)
+                                        // UART polls (~1 ms) of dark light needed before sending, the first one can be cut short (Don't change this)
+// ----------------------------------------------------------
+// ----------- SELECT ADDRESSING (same as the receiver) -----
+#define ADDRESSING        0             // 1 = the header also holds the destination, other nodes sleep through the frame
+#define DESTINATION       0xFF          // Node address (0x00 to 0xEF), multicast group (ADDRESS_GROUP + 0 to 14) or broadcast
+#define ADDRESS_GROUP     0xF0          // First multicast group address
+#define ADDRESS_BROADCAST 0xFF          // Every node
 // ----------------------------------------------------------
 // ----------- SELECT BUFFER SIZE ---------------------------
-#define BUFFER_SIZE    32          // (bytes)
-#define PACKET_SIZE    1 + BUFFER_SIZE * 8 + sizeof(crc) * 8 + 1        // (bits)   (Don't change this)
+#define BUFFER_SIZE    32          // (bytes) longest payload of a frame (255 max, same as the receiver)
+#define HEADER_SIZE    (1 + ADDRESSING)    // (bytes) payload length and destination, sent before the data and covered by the crc
+#if FOUNTAIN
+#define BUFFER_COUNT   (2 * FOUNTAIN_K)                         // A block is filled while the last one is on the air (Don't change this)
+#define BUFFER_FILL    (FOUNTAIN_SYMBOL_SIZE - HEADER_SIZE)     // (bytes) from the computer per buffer (Don't change this)
+#define UNSENT_BYTES   (buffer_pos != 0 || frames_ready % FOUNTAIN_K != 0)     // Only whole blocks go out (Don't change this)
+#elif ARQ
+#define BUFFER_COUNT   ARQ_WINDOW                               // Sent frames stay here until they are acked (Don't change this)
+#define BUFFER_FILL    (BUFFER_SIZE - ARQ_HEADER)               // (bytes) from the computer per buffer (Don't change this)
+#define UNSENT_BYTES   (buffer_pos != 0)
+#else
+#define BUFFER_COUNT   2           // Frames accepted from the computer while one is on the air (2 = ping-pong)
+#define BUFFER_FILL    BUFFER_SIZE
+#define UNSENT_BYTES   (buffer_pos != 0)
+#endif
+#define FRAME_BITS     (1 + PREAMBLE_BITS + SYNC_BITS + HEADER_BITS + BLOCK_BITS(BUFFER_SIZE + sizeof(crc)) + 1)       // (bits) longest frame (Don't change this)
+#define DATA_SYMBOLS   ((HEADER_BITS + BLOCK_BITS(BUFFER_SIZE + sizeof(crc)) + GROUP_BITS - 1) / GROUP_BITS * GROUP_SYMBOLS)      // (symbols) header and block, last group padded (Don't change this)
+#define PACKET_SIZE    ((FRAME_BITS - HEADER_BITS - BLOCK_BITS(BUFFER_SIZE + sizeof(crc))) * SYMBOLS_PER_BIT + TRAINING_SYMBOLS + DATA_SYMBOLS + 1 + RS_GAP_SYMBOLS)      // (symbols) one more to return to idle (Don't change this)
 // ----------------------------------------------------------
 // ----------- SELECT START/STOP BITS -----------------------
 #define START_BIT      1
 #define STOP_BIT       0
 // ----------------------------------------------------------
-// ----------- CRC ------------------------------------------
-typedef char crc;                   // Decides of the size of the crc (8 or 16 only)
-#define POLYNOMIAL 0x31                 // The generator polynomial
+// ----------- SELECT PREAMBLE/SYNC WORD (same as the receiver)
+typedef unsigned int sync_word;         // Decides of the size of the sync word (unsigned long for 32 bits)
+#define PREAMBLE_BITS  8                // Alternating bits sent after the start bit
+#define SYNC_WORD      0x1F35           // Barker 13, sent LSB first after the preamble
+#define SYNC_BITS      (8 * sizeof(sync_word))      // (Don't change this)
+// ----------------------------------------------------------
+// ----------- CRC (same as the receiver) -------------------
+#define CRC_16         0                // CRC-16-CCITT from the CRC module, fed by DMA
+#define CRC_32         1                // CRC-32 in software (no CRC32 module on the F5529)
+#define CRC_TYPE       CRC_16
+#define CRC_SEED       0xFFFF           // CRC-16 initial value, catches leading zero bytes
+#if CRC_TYPE == CRC_16
+typedef uint16_t crc;
+#else
+typedef uint32_t crc;
+#endif
+#define POLYNOMIAL 0x04C11DB7           // The CRC-32 generator polynomial
 #define WIDTH  (8 * sizeof(crc))        // The crc's width (Don't change this)
-#define TOPBIT (1 << (WIDTH - 1))       // Leftmost bit (Don't change this)
+#define TOPBIT ((crc)1 << (WIDTH - 1))  // Leftmost bit (Don't change this)
+// ----------------------------------------------------------
+// ----------- SELECT SCRAMBLER (same as the receiver) ------
+#define SCRAMBLER       0               // 1 = payload and crc go through a self-synchronizing x^7 + x^6 + 1 scrambler
+#define SCRAMBLER_SEED  0x55            // Last 7 scrambled bits before the first byte, neither all 0s nor all 1s
+// ----------------------------------------------------------
+// ----------- SELECT ERROR CORRECTION (same as the receiver)
+#define FEC_NONE       0                // Length, data and crc are sent as they are
+#define FEC_HAMMING    1                // Extended Hamming(8,4) on every nibble, corrects 1 and detects 2 wrong bits
+#define FEC_REED_SOLOMON 2              // RS over GF(256) on the whole frame, corrects RS_PARITY / 2 wrong bytes (bursts)
+#define FEC_CONVOLUTIONAL 3             // Rate 1/2 convolutional code, soft decision Viterbi decoding on the receiver
+#define FEC            FEC_NONE
+
+#define RS_PARITY      8                // (bytes) added to every frame, even (HEADER_SIZE + BUFFER_SIZE + crc + RS_PARITY <= 255), 18 at most at TIMER_COUNTER 480 or the receiver's rsFeed() outlasts a symbol
+#define RS_GF_CYCLES   40               // (cycles) a gfMul() or gfDiv() of the receiver with the loop step around it (estimate, see Tools/sim/rs_bench)
+#define RS_STEP_CYCLES 22               // (cycles) a multiplication it does as one step in gf_exp[] (Chien search, Forney)
+#define RS_DECODE_CYCLES(n) ((unsigned long)RS_GF_CYCLES * (RS_PARITY * (2 * RS_PARITY + 1) + RS_PARITY * (RS_PARITY / 2 + 1) + RS_PARITY) \
+                             + (unsigned long)RS_STEP_CYCLES * (RS_PARITY / 2) * ((n) + RS_PARITY + RS_PARITY / 4 + 1))
+                                        // (cycles) longest rsDecode() for a codeword of n bytes: Berlekamp-Massey, evaluator, Chien, Forney (Don't change this)
+#if FEC == FEC_REED_SOLOMON
+#define RS_GAP_SYMBOLS (RS_DECODE_CYCLES(HEADER_SIZE + BUFFER_SIZE + sizeof(crc) + RS_PARITY) \
+                        / ((TIMER_COUNTER * GROUP_BITS / GROUP_SYMBOLS / LEVEL_BITS) >> (RATE_ADAPT ? RATE_STEPS : 0)) + 1)
+                                        // Idle symbols after the longest frame, the receiver decodes before the next start bit (Don't change this)
+#else
+#define RS_GAP_SYMBOLS 0
+#endif
+#define HEADER_COPIES  3                // With RS or convolutional coding every header byte is sent 3 times and voted, the length tells where the codeword ends (Don't change this)
+#define CONV_K         5                // Constraint length, 3, 5 or 7 (the receiver does 2^(CONV_K-1) states per bit)
+
+#if CONV_K == 3
+#define CONV_POLY_A    07               // Generator polynomials, best free distance for CONV_K (Don't change this)
+#define CONV_POLY_B    05
+#elif CONV_K == 5
+#define CONV_POLY_A    023
+#define CONV_POLY_B    035
+#else
+#define CONV_POLY_A    0171
+#define CONV_POLY_B    0133
+#endif
+#define CONV_STATES    (1 << (CONV_K - 1))      // (Don't change this)
+
+#if FEC == FEC_HAMMING                  // Bits on the air for the length, and for that many bytes of data and crc (Don't change this)
+#define HEADER_BITS        (HEADER_SIZE * 16)
+#define BLOCK_BITS(bytes)  ((bytes) * 16)
+#elif FEC == FEC_REED_SOLOMON
+#define HEADER_BITS        (HEADER_COPIES * HEADER_SIZE * 8)
+#define BLOCK_BITS(bytes)  (((bytes) + RS_PARITY) * 8)
+#elif FEC == FEC_CONVOLUTIONAL
+#define HEADER_BITS        (HEADER_COPIES * HEADER_SIZE * 8)
+#define BLOCK_BITS(bytes)  (((bytes) * 8 + CONV_K - 1) * 2)
+#else
+#define HEADER_BITS        (HEADER_SIZE * 8)
+#define BLOCK_BITS(bytes)  ((bytes) * 8)
+#endif
+// ----------------------------------------------------------
+// ----------- SELECT INTERLEAVER (same as the receiver) ----
+#define INTERLEAVE_ROWS  1              // Coded bits after the length are written in rows and sent by columns (1 = off)
+                                        // Neighbours on the air are then a row apart in the codewords, a burst is spread out
+#define INTERLEAVE_BYTES ((BLOCK_BITS(BUFFER_SIZE + sizeof(crc)) + 7) / 8)     // (Don't change this)
 // ----------------------------------------------------------
 
 
 //functions
 void acquireData();
+char storeByte(char byte);
+void closeBuffer();
+void flushBuffers();
+void readUartRing();
 void sendPacket();
+void listenBeforeTalk();
+void waitPolls(unsigned int polls);
+unsigned int csmaRandom();
+void sendFountain();
+void fountainInit();
+double solitonWeight(unsigned int degree, double spread, unsigned int spike);
+unsigned int fountainRandom();
+unsigned int fountainNeighbours(unsigned int id);
+void arqUpdate();
+char arqSelect();
+void rateUpdate();
+void setRate(unsigned char rate);
+void buildPacket();
+void putByte(char byte);
+void putCodedByte(char byte);
+char scramble(char byte);
+void putHeader(char const *header);
+void putParity();
+void putDecodeGap(unsigned int length);
+unsigned char gfMul(unsigned char a, unsigned char b);
+void rsInit();
+void rsEncode(unsigned char byte);
+char parity(unsigned int value);
+void putConvBit(char bit);
+void putCodeBit(char bit);
+void startInterleaver();
+void putInterleaved();
+void interleaverStart(unsigned int bits);
+unsigned int interleaverNext();
+void putDataBit(char bit);
+void putGroup();
+void flushGroup();
+void putBit(char bit);
+void startTimerTransmit();
+void startDmaTransmit();
 void crcInit(void);
 crc calculateChecksum(char const message[], int nBytes);
 
@@ -37,13 +350,199 @@ crc calculateChecksum(char const message[], int nBytes);
 //attributes
 char temp;
 volatile unsigned long i = 0;
+#if CRC_TYPE == CRC_32
 crc crcTable[256];
-int buffer_pos;
-char buffer[BUFFER_SIZE];
-char packet[PACKET_SIZE];    //start bit + data bits + crc + stop bit
+#endif
+unsigned int buffer_pos;
+char buffer[BUFFER_COUNT][HEADER_SIZE + BUFFER_SIZE];     // Payload length (and destination), then the payload
+volatile unsigned int fill_index, send_index, frames_ready;
+char uart_ring[UART_RING_SIZE];
+unsigned int ring_tail, ring_last_head;
+volatile unsigned int ring_unread;      // Bytes DMA1 wrote that readUartRing() didn't take yet
+unsigned int uart_overruns;             // Times DMA1 went round onto unread bytes, for the debugger
+volatile unsigned int idle_polls;
+char packet[PACKET_SIZE];    //start bit + preamble + sync word + data bits + crc + stop bit, as line symbols
+unsigned int packet_length;
+char line_level;
+unsigned int group, group_fill;
+unsigned char disparity;        // 8b10b running disparity, 0 = RD-, 1 = RD+
 volatile unsigned int data_received, timer_active;
 volatile unsigned int sending;
+volatile unsigned int tx_pos;
+volatile char tx_late;                  // The ISR set TA1CCR1 after TA1R had passed it, the frame was cut short
+unsigned int tx_late_frames;            // Frames given up after TX_RETRIES, for the debugger
+unsigned int conv_state;
+unsigned char scrambler_state;  // Last 7 scrambled bits, oldest in bit 0
+char interleaving;
+unsigned char coded_bits[INTERLEAVE_BYTES];     // Coded bits in codeword order, waiting to be interleaved
+unsigned int code_pos;
+unsigned int il_bits, il_columns, il_column, il_row, il_index;
 uint32_t smclk;
+#if FOUNTAIN
+char fountain_frame[HEADER_SIZE + BUFFER_SIZE];     // Length, block number, symbol id, then the coded buffers
+unsigned char fountain_block;
+unsigned int fountain_id;
+char fountain_active;
+unsigned int fountain_cdf[FOUNTAIN_K];              // Degree distribution, cumulative and scaled to 65535
+uint16_t fountain_random;                           // xorshift16 state, the sequence needs it 16 bits wide
+#endif
+#if ARQ
+unsigned char arq_base, arq_next;       // Oldest unacked sequence number, first one never sent
+unsigned char arq_fill_seq;             // Sequence number of the buffer being filled
+unsigned char arq_acked, arq_resend;    // Buffers acked out of order, buffers to send again (bit = buffer)
+unsigned char arq_stamp[ARQ_WINDOW];    // arq_sent when each buffer last went on the air
+unsigned char arq_sent;
+unsigned char arq_ack_bytes[ARQ_ACK_SIZE];
+unsigned int arq_ack_pos;
+volatile unsigned char arq_ack_base, arq_ack_bits, arq_ack_last;
+volatile char arq_ack_new, arq_timeout;
+volatile unsigned int arq_polls;
+#endif
+#if RATE_ADAPT
+unsigned char link_rate;                // 0 = TIMER_COUNTER, every step halves SYMBOL_PERIOD
+unsigned char rate_sent, rate_resent;   // Frames of this window, and how many of them went again
+unsigned char rate_failed, rate_hold;   // Last rate that was too fast, clean windows before it is tried again
+unsigned char rate_timeouts;
+volatile unsigned int rate_idle_polls;
+char link_frame[HEADER_SIZE + LINK_SIZE];   // Length (and destination), the next rate and the copies after this one
+char link_sending;
+#endif
+#if TDMA
+volatile unsigned int tdma_polls;       // UART polls since the superframe started
+volatile char tdma_turn, tdma_synced;   // First poll of our slot, beacon seen (the master is always in sync)
+#endif
+#if CSMA
+volatile char csma_heard;               // Light seen while listening
+volatile unsigned int csma_polls;
+unsigned int csma_random;
+unsigned int csma_busy;                 // Looks that found somebody else on the air, for the debugger
+#endif
+
+#if LINE_CODE == LINE_4B5B
+// 4B5B code of each nibble (bit 0 = first symbol), never more than three 0s in a row
+const unsigned char line_4b5b[16] = {
+    0x0F, 0x12, 0x05, 0x15, 0x0A, 0x1A, 0x0E, 0x1E, 0x09, 0x19, 0x0D, 0x1D, 0x0B, 0x1B, 0x07, 0x17
+};
+#elif LINE_CODE == LINE_8B10B
+// 5b/6b sub-block of bits 0-4 for RD- and RD+ (bit 0 = first symbol), 0x40 when it changes the disparity
+const unsigned char line_5b6b[2][32] = {
+    {
+        0x79, 0x6E, 0x6D, 0x23, 0x6B, 0x25, 0x26, 0x07, 0x67, 0x29, 0x2A, 0x0B, 0x2C, 0x0D, 0x0E, 0x7A,
+        0x76, 0x31, 0x32, 0x13, 0x34, 0x15, 0x16, 0x57, 0x73, 0x19, 0x1A, 0x5B, 0x1C, 0x5D, 0x5E, 0x75
+    },
+    {
+        0x46, 0x51, 0x52, 0x23, 0x54, 0x25, 0x26, 0x38, 0x58, 0x29, 0x2A, 0x0B, 0x2C, 0x0D, 0x0E, 0x45,
+        0x49, 0x31, 0x32, 0x13, 0x34, 0x15, 0x16, 0x68, 0x4C, 0x19, 0x1A, 0x64, 0x1C, 0x62, 0x61, 0x4A
+    }
+};
+
+// 3b/4b sub-block of bits 5-7 for RD- and RD+, index 8 is A7, 0x10 when it changes the disparity
+const unsigned char line_3b4b[2][9] = {
+    {0x1D, 0x09, 0x0A, 0x03, 0x1B, 0x05, 0x06, 0x17, 0x1E},
+    {0x12, 0x09, 0x0A, 0x0C, 0x14, 0x05, 0x06, 0x18, 0x11}
+};
+#endif
+
+#if SCRAMBLER
+// Scrambled byte from a zero history, and the part the last 7 scrambled bits add to it (the scrambler is linear)
+const unsigned char scramble_input[256] = {
+    0x00, 0xC1, 0x82, 0x43, 0x04, 0xC5, 0x86, 0x47, 0x08, 0xC9, 0x8A, 0x4B, 0x0C, 0xCD, 0x8E, 0x4F,
+    0x10, 0xD1, 0x92, 0x53, 0x14, 0xD5, 0x96, 0x57, 0x18, 0xD9, 0x9A, 0x5B, 0x1C, 0xDD, 0x9E, 0x5F,
+    0x20, 0xE1, 0xA2, 0x63, 0x24, 0xE5, 0xA6, 0x67, 0x28, 0xE9, 0xAA, 0x6B, 0x2C, 0xED, 0xAE, 0x6F,
+    0x30, 0xF1, 0xB2, 0x73, 0x34, 0xF5, 0xB6, 0x77, 0x38, 0xF9, 0xBA, 0x7B, 0x3C, 0xFD, 0xBE, 0x7F,
+    0x40, 0x81, 0xC2, 0x03, 0x44, 0x85, 0xC6, 0x07, 0x48, 0x89, 0xCA, 0x0B, 0x4C, 0x8D, 0xCE, 0x0F,
+    0x50, 0x91, 0xD2, 0x13, 0x54, 0x95, 0xD6, 0x17, 0x58, 0x99, 0xDA, 0x1B, 0x5C, 0x9D, 0xDE, 0x1F,
+    0x60, 0xA1, 0xE2, 0x23, 0x64, 0xA5, 0xE6, 0x27, 0x68, 0xA9, 0xEA, 0x2B, 0x6C, 0xAD, 0xEE, 0x2F,
+    0x70, 0xB1, 0xF2, 0x33, 0x74, 0xB5, 0xF6, 0x37, 0x78, 0xB9, 0xFA, 0x3B, 0x7C, 0xBD, 0xFE, 0x3F,
+    0x80, 0x41, 0x02, 0xC3, 0x84, 0x45, 0x06, 0xC7, 0x88, 0x49, 0x0A, 0xCB, 0x8C, 0x4D, 0x0E, 0xCF,
+    0x90, 0x51, 0x12, 0xD3, 0x94, 0x55, 0x16, 0xD7, 0x98, 0x59, 0x1A, 0xDB, 0x9C, 0x5D, 0x1E, 0xDF,
+    0xA0, 0x61, 0x22, 0xE3, 0xA4, 0x65, 0x26, 0xE7, 0xA8, 0x69, 0x2A, 0xEB, 0xAC, 0x6D, 0x2E, 0xEF,
+    0xB0, 0x71, 0x32, 0xF3, 0xB4, 0x75, 0x36, 0xF7, 0xB8, 0x79, 0x3A, 0xFB, 0xBC, 0x7D, 0x3E, 0xFF,
+    0xC0, 0x01, 0x42, 0x83, 0xC4, 0x05, 0x46, 0x87, 0xC8, 0x09, 0x4A, 0x8B, 0xCC, 0x0D, 0x4E, 0x8F,
+    0xD0, 0x11, 0x52, 0x93, 0xD4, 0x15, 0x56, 0x97, 0xD8, 0x19, 0x5A, 0x9B, 0xDC, 0x1D, 0x5E, 0x9F,
+    0xE0, 0x21, 0x62, 0xA3, 0xE4, 0x25, 0x66, 0xA7, 0xE8, 0x29, 0x6A, 0xAB, 0xEC, 0x2D, 0x6E, 0xAF,
+    0xF0, 0x31, 0x72, 0xB3, 0xF4, 0x35, 0x76, 0xB7, 0xF8, 0x39, 0x7A, 0xBB, 0xFC, 0x3D, 0x7E, 0xBF
+};
+
+const unsigned char scramble_history[128] = {
+    0x00, 0xC1, 0x43, 0x82, 0x86, 0x47, 0xC5, 0x04, 0x0C, 0xCD, 0x4F, 0x8E, 0x8A, 0x4B, 0xC9, 0x08,
+    0x18, 0xD9, 0x5B, 0x9A, 0x9E, 0x5F, 0xDD, 0x1C, 0x14, 0xD5, 0x57, 0x96, 0x92, 0x53, 0xD1, 0x10,
+    0x30, 0xF1, 0x73, 0xB2, 0xB6, 0x77, 0xF5, 0x34, 0x3C, 0xFD, 0x7F, 0xBE, 0xBA, 0x7B, 0xF9, 0x38,
+    0x28, 0xE9, 0x6B, 0xAA, 0xAE, 0x6F, 0xED, 0x2C, 0x24, 0xE5, 0x67, 0xA6, 0xA2, 0x63, 0xE1, 0x20,
+    0x60, 0xA1, 0x23, 0xE2, 0xE6, 0x27, 0xA5, 0x64, 0x6C, 0xAD, 0x2F, 0xEE, 0xEA, 0x2B, 0xA9, 0x68,
+    0x78, 0xB9, 0x3B, 0xFA, 0xFE, 0x3F, 0xBD, 0x7C, 0x74, 0xB5, 0x37, 0xF6, 0xF2, 0x33, 0xB1, 0x70,
+    0x50, 0x91, 0x13, 0xD2, 0xD6, 0x17, 0x95, 0x54, 0x5C, 0x9D, 0x1F, 0xDE, 0xDA, 0x1B, 0x99, 0x58,
+    0x48, 0x89, 0x0B, 0xCA, 0xCE, 0x0F, 0x8D, 0x4C, 0x44, 0x85, 0x07, 0xC6, 0xC2, 0x03, 0x81, 0x40
+};
+#endif
+
+#if FEC == FEC_HAMMING
+// Extended Hamming(8,4) codeword of each nibble (bit 0 = overall parity, bits 1 to 7 = Hamming(7,4) positions)
+const char hamming_encode[16] = {
+    0x00, 0x0F, 0x33, 0x3C, 0x55, 0x5A, 0x66, 0x69, 0x96, 0x99, 0xA5, 0xAA, 0xC3, 0xCC, 0xF0, 0xFF
+};
+#endif
+
+#if FEC == FEC_REED_SOLOMON
+unsigned char rs_generator[RS_PARITY + 1];
+unsigned char rs_parity[RS_PARITY];
+
+// Powers of the GF(256) generator a = 2, twice so that a product never needs a modulo
+const unsigned char gf_exp[512] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26,
+    0x4C, 0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0,
+    0x9D, 0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23,
+    0x46, 0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1,
+    0x5F, 0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0,
+    0xFD, 0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2,
+    0xD9, 0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE,
+    0x81, 0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC,
+    0x85, 0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54,
+    0xA8, 0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73,
+    0xE6, 0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF,
+    0xE3, 0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41,
+    0x82, 0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6,
+    0x51, 0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09,
+    0x12, 0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16,
+    0x2C, 0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01,
+    0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26, 0x4C,
+    0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0, 0x9D,
+    0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23, 0x46,
+    0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1, 0x5F,
+    0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0, 0xFD,
+    0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2, 0xD9,
+    0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE, 0x81,
+    0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC, 0x85,
+    0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54, 0xA8,
+    0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73, 0xE6,
+    0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF, 0xE3,
+    0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41, 0x82,
+    0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6, 0x51,
+    0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09, 0x12,
+    0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16, 0x2C,
+    0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01, 0x02
+};
+
+// Discrete logarithm of every non-zero GF(256) element
+const unsigned char gf_log[256] = {
+    0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1A, 0xC6, 0x03, 0xDF, 0x33, 0xEE, 0x1B, 0x68, 0xC7, 0x4B,
+    0x04, 0x64, 0xE0, 0x0E, 0x34, 0x8D, 0xEF, 0x81, 0x1C, 0xC1, 0x69, 0xF8, 0xC8, 0x08, 0x4C, 0x71,
+    0x05, 0x8A, 0x65, 0x2F, 0xE1, 0x24, 0x0F, 0x21, 0x35, 0x93, 0x8E, 0xDA, 0xF0, 0x12, 0x82, 0x45,
+    0x1D, 0xB5, 0xC2, 0x7D, 0x6A, 0x27, 0xF9, 0xB9, 0xC9, 0x9A, 0x09, 0x78, 0x4D, 0xE4, 0x72, 0xA6,
+    0x06, 0xBF, 0x8B, 0x62, 0x66, 0xDD, 0x30, 0xFD, 0xE2, 0x98, 0x25, 0xB3, 0x10, 0x91, 0x22, 0x88,
+    0x36, 0xD0, 0x94, 0xCE, 0x8F, 0x96, 0xDB, 0xBD, 0xF1, 0xD2, 0x13, 0x5C, 0x83, 0x38, 0x46, 0x40,
+    0x1E, 0x42, 0xB6, 0xA3, 0xC3, 0x48, 0x7E, 0x6E, 0x6B, 0x3A, 0x28, 0x54, 0xFA, 0x85, 0xBA, 0x3D,
+    0xCA, 0x5E, 0x9B, 0x9F, 0x0A, 0x15, 0x79, 0x2B, 0x4E, 0xD4, 0xE5, 0xAC, 0x73, 0xF3, 0xA7, 0x57,
+    0x07, 0x70, 0xC0, 0xF7, 0x8C, 0x80, 0x63, 0x0D, 0x67, 0x4A, 0xDE, 0xED, 0x31, 0xC5, 0xFE, 0x18,
+    0xE3, 0xA5, 0x99, 0x77, 0x26, 0xB8, 0xB4, 0x7C, 0x11, 0x44, 0x92, 0xD9, 0x23, 0x20, 0x89, 0x2E,
+    0x37, 0x3F, 0xD1, 0x5B, 0x95, 0xBC, 0xCF, 0xCD, 0x90, 0x87, 0x97, 0xB2, 0xDC, 0xFC, 0xBE, 0x61,
+    0xF2, 0x56, 0xD3, 0xAB, 0x14, 0x2A, 0x5D, 0x9E, 0x84, 0x3C, 0x39, 0x53, 0x47, 0x6D, 0x41, 0xA2,
+    0x1F, 0x2D, 0x43, 0xD8, 0xB7, 0x7B, 0xA4, 0x76, 0xC4, 0x17, 0x49, 0xEC, 0x7F, 0x0C, 0x6F, 0xF6,
+    0x6C, 0xA1, 0x3B, 0x52, 0x29, 0x9D, 0x55, 0xAA, 0xFB, 0x60, 0x86, 0xB1, 0xBB, 0xCC, 0x3E, 0x5A,
+    0xCB, 0x59, 0x5F, 0xB0, 0x9C, 0xA9, 0xA0, 0x51, 0x0B, 0xF5, 0x16, 0xEB, 0x7A, 0x75, 0x2C, 0xD7,
+    0x4F, 0xAE, 0xD5, 0xE9, 0xE6, 0xE7, 0xAD, 0xE8, 0x74, 0xD6, 0xF4, 0xEA, 0xA8, 0x50, 0x58, 0xAF
+};
+#endif
 
 //interruption flags
 int USCI_A1_INT = 0;
@@ -63,7 +562,7 @@ int main(void) {
     // SET CLOCK
     UCS_initClockSignal(UCS_SMCLK, UCS_DCOCLK_SELECT, UCS_CLOCK_DIVIDER_1);    // Select SMCLK to be DCO
     PMM_setVCore(PMM_CORE_LEVEL_3);                                            // Set VCore Up to level 3 to be able to run higher than 20 MHz
-    UCS_initFLLSettle(CLOCK_FREQUENCY*2, CLOCK_FREQUENCY / 32768);             // Set clock source to selected frequency
+    UCS_initFLLSettle(CLOCK_FREQUENCY / 1000, CLOCK_FREQUENCY / 32768);        // Set clock source to selected frequency (kHz)
 
     smclk = UCS_getSMCLK();
 
@@ -85,9 +584,54 @@ int main(void) {
 
 
     // SET TIMER
+#if TX_ENGINE == TX_SOFTWARE
     TA0CCTL0 = CCIE;                        // CCR0 interrupt enabled
-    TA0CCR0 = TIMER_COUNTER;                // Sample every X cycles
+    TA0CCR0 = SYMBOL_PERIOD - 1;            // One symbol every X cycles (up mode counts CCR0 + 1)
     TA0CTL = TASSEL_2 + MC_1 + TACLR;
+#elif TX_ENGINE == TX_DMA
+    TA0CCTL0 = 0;                           // No CCR0 interrupt, the flag only triggers the DMA
+    TA0CCR0 = SYMBOL_PERIOD - 1;            // One symbol every X cycles (up mode counts CCR0 + 1)
+    TA0CTL = TASSEL_2 + MC_0 + TACLR;       // Stopped until a frame is ready
+
+    // SET DMA
+    DMA_initParam dma_param = {0};
+    dma_param.channelSelect = DMA_CHANNEL_0;
+    dma_param.transferModeSelect = DMA_TRANSFER_SINGLE;         // One byte per trigger
+    dma_param.transferSize = PACKET_SIZE;
+    dma_param.triggerSourceSelect = DMA_TRIGGERSOURCE_1;        // TA0CCR0 CCIFG
+#if PULSE_AMPLITUDE
+    dma_param.transferUnitSelect = DMA_SIZE_SRCBYTE_DSTWORD;    // Duty cycle bytes into TB0CCR2
+#else
+    dma_param.transferUnitSelect = DMA_SIZE_SRCBYTE_DSTBYTE;
+#endif
+    dma_param.triggerTypeSelect = DMA_TRIGGER_RISINGEDGE;
+    DMA_init(&dma_param);
+    DMA_setSrcAddress(DMA_CHANNEL_0, (uint32_t)(uintptr_t)packet, DMA_DIRECTION_INCREMENT);
+#if PULSE_AMPLITUDE
+    DMA_setDstAddress(DMA_CHANNEL_0, (uint32_t)(uintptr_t)&TB0CCR2, DMA_DIRECTION_UNCHANGED);
+#else
+    DMA_setDstAddress(DMA_CHANNEL_0, (uint32_t)(uintptr_t)&P2OUT, DMA_DIRECTION_UNCHANGED);
+#endif
+    DMA_enableInterrupt(DMA_CHANNEL_0);     // Wake up once the stop bit is on the air
+#else
+    TA1CCTL1 = OUTMOD_0 + OUT;              // TA1.1 holds the idle level until a frame starts
+    TA1CTL = TASSEL_2 + MC_2 + TACLR;       // SMCLK, continuous mode (edges are scheduled with CCR1)
+#endif
+
+#if PULSE_AMPLITUDE
+    // SET LED PWM, the duty cycle of TB0.2 is the light level
+    Timer_B_outputPWMParam pwm_param = {0};
+    pwm_param.clockSource = TIMER_B_CLOCKSOURCE_SMCLK;
+    pwm_param.clockSourceDivider = TIMER_B_CLOCKSOURCE_DIVIDER_1;
+    pwm_param.timerPeriod = PAM_PWM_PERIOD - 1;                 // A duty of PAM_PWM_PERIOD never resets the output, full light
+    pwm_param.compareRegister = TIMER_B_CAPTURECOMPARE_REGISTER_2;
+    pwm_param.compareOutputMode = TIMER_B_OUTPUTMODE_RESET_SET;
+    pwm_param.dutyCycle = 0;                                    // Idle, LED off
+    Timer_B_outputPWM(TIMER_B0_BASE, &pwm_param);
+    TB0CCTL2 |= CLLD_1;                     // A new duty cycle waits for the end of the PWM period
+    P7DIR |= BIT4;
+    P7SEL |= BIT4;                          // P7.4 = TB0.2, to the LED driver
+#endif
 
 
     // SET UART
@@ -100,32 +644,173 @@ int main(void) {
     int modulation = round((n - (int)(n))*8);
     UCA1MCTL |= modulation + UCBRF_0;               // Select the correct modulation
     UCA1CTL1 &= ~UCSWRST;                           // Start the UART state machine
+#if UART_RX_DMA
+    DMA_initParam uart_dma_param = {0};
+    uart_dma_param.channelSelect = DMA_CHANNEL_1;
+    uart_dma_param.transferModeSelect = DMA_TRANSFER_REPEATED_SINGLE;   // Wraps around uart_ring forever
+    uart_dma_param.transferSize = UART_RING_SIZE;
+    uart_dma_param.triggerSourceSelect = DMA_TRIGGERSOURCE_20;          // UCA1RXIFG
+    uart_dma_param.transferUnitSelect = DMA_SIZE_SRCBYTE_DSTBYTE;
+    uart_dma_param.triggerTypeSelect = DMA_TRIGGER_RISINGEDGE;
+    DMA_init(&uart_dma_param);
+    DMA_setSrcAddress(DMA_CHANNEL_1, USCI_A_UART_getReceiveBufferAddressForDMA(USCI_A1_BASE), DMA_DIRECTION_UNCHANGED);
+    DMA_setDstAddress(DMA_CHANNEL_1, (uint32_t)(uintptr_t)uart_ring, DMA_DIRECTION_INCREMENT);
+    DMA_enableTransfers(DMA_CHANNEL_1);
+#else
     UCA1IE |= UCRXIE;                               // Enable USCI_A1 RX interrupts
+#endif
+#if ARQ
+    // SET RETURN CHANNEL, acks from the receiver
+    P3SEL |= BIT4;                                  // P3.4 = UCA0RXD
+    UCA0CTL1 |= UCSWRST;
+    UCA0CTL1 |= UCSSEL_2;                           // SMCLK
+    n = CLOCK_FREQUENCY / ARQ_BAUD_RATE;
+    UCA0BR0 = (int)(n) & 0xFF;
+    UCA0BR1 = (int)(n) >> 8;
+    modulation = round((n - (int)(n))*8);
+    UCA0MCTL |= modulation + UCBRF_0;
+    UCA0CTL1 &= ~UCSWRST;
+    UCA0IE |= UCRXIE;                               // Enable USCI_A0 RX interrupts
+#endif
+#if TDMA
+    // SET BEACON LINE
+    P3SEL |= BIT3 + BIT4;                           // P3.3 = UCA0TXD  and  P3.4 = UCA0RXD
+    UCA0CTL1 |= UCSWRST;
+    UCA0CTL1 |= UCSSEL_2;                           // SMCLK
+    n = CLOCK_FREQUENCY / TDMA_BAUD_RATE;
+    UCA0BR0 = (int)(n) & 0xFF;
+    UCA0BR1 = (int)(n) >> 8;
+    modulation = round((n - (int)(n))*8);
+    UCA0MCTL |= modulation + UCBRF_0;
+    UCA0CTL1 &= ~UCSWRST;
+#if !TDMA_MASTER
+    UCA0IE |= UCRXIE;                               // Enable USCI_A0 RX interrupts, the beacon
+#endif
+#endif
+    TA2CCTL0 = CCIE;                                // Look at the UART every UART_POLL_COUNTER
+    TA2CCR0 = UART_POLL_COUNTER - 1;
+    TA2CTL = TASSEL_1 + MC_1 + TACLR;               // ACLK, up mode
 
 
     P2DIR |= BIT0;              //Set output pin (P2.0)
     P2OUT |= BIT0;
+#if TX_ENGINE == TX_TIMER
+    P2SEL |= BIT0;              //P2.0 driven by TA1.1
+#endif
+#if CSMA
+    P2DIR &= ~BIT4;             //input pin (P2.4), photodiode
+    P2REN |= BIT4;
+    P2OUT &= ~BIT4;             //pull-down, dark when nothing is connected
+    P2IES &= ~BIT4;             //interrupt on rising edge, only enabled while listening
+#endif
 
     timer_active = 0;
     data_received = 0;
     buffer_pos = 0;
+    fill_index = 0;
+    send_index = 0;
+    frames_ready = 0;
+    ring_tail = 0;
+    ring_last_head = 0;
+    ring_unread = 0;
+    uart_overruns = 0;
+    idle_polls = 0;
     sending = 0;
 
+    // SET CRC
+#if CRC_TYPE == CRC_16
+    DMA_initParam crc_dma_param = {0};
+    crc_dma_param.channelSelect = DMA_CHANNEL_2;
+    crc_dma_param.transferModeSelect = DMA_TRANSFER_BLOCK;      // Whole frame buffer in one request
+    crc_dma_param.transferSize = BUFFER_SIZE;
+    crc_dma_param.triggerSourceSelect = DMA_TRIGGERSOURCE_0;    // DMAREQ, started by software
+    crc_dma_param.transferUnitSelect = DMA_SIZE_SRCBYTE_DSTBYTE;
+    crc_dma_param.triggerTypeSelect = DMA_TRIGGER_RISINGEDGE;
+    DMA_init(&crc_dma_param);
+    DMA_setDstAddress(DMA_CHANNEL_2, CRC_BASE + OFS_CRCDI_L, DMA_DIRECTION_UNCHANGED);
+#else
     crcInit();
-    CRC_setSeed(CRC_BASE, 0x0000);
+#endif
+#if FEC == FEC_REED_SOLOMON
+    rsInit();
+#endif
+#if FOUNTAIN
+    fountainInit();
+    fountain_active = 0;
+#endif
+#if ARQ
+    arq_base = 0;
+    arq_next = 0;
+    arq_fill_seq = 0;
+    arq_acked = 0;
+    arq_resend = 0;
+    arq_sent = 0;
+    arq_ack_pos = 0;
+    arq_ack_new = 0;
+    arq_timeout = 0;
+    arq_polls = 0;
+#endif
+#if RATE_ADAPT
+    link_rate = 0;
+    rate_sent = 0;
+    rate_resent = 0;
+    rate_failed = 0;
+    rate_hold = 0;
+    rate_timeouts = 0;
+    rate_idle_polls = 0;
+    link_sending = 0;
+#endif
+#if TDMA
+    tdma_polls = 0;
+    tdma_turn = 0;
+    tdma_synced = TDMA_MASTER;
+#endif
+#if CSMA
+    csma_heard = 0;
+    csma_polls = 0;
+    csma_busy = 0;
+    ADC12CTL0 |= ADC12SC;                   // The noise on P6.0 makes every board back off differently
+    while (ADC12CTL1 & ADC12BUSY);
+    csma_random = ADC12MEM0;
+#endif
 
     __enable_interrupt();
 
 
     while(1) {
 
-        __bis_SR_register(LPM0_bits + GIE);       // CPU off, enable interrupts
+#if UART_RX_DMA
+        readUartRing();
+#endif
+
+        __disable_interrupt();
+#if FOUNTAIN
+        if (!fountain_active && frames_ready < FOUNTAIN_K) {
+#elif ARQ
+        if (!arq_ack_new && !arq_timeout && arq_resend == 0 && (unsigned char)(arq_next - arq_base) == frames_ready) {
+#else
+        if (frames_ready == 0) {
+#endif
+            __bis_SR_register(LPM0_bits + GIE);   // CPU off until a whole buffer or an idle line
+        }
+        __enable_interrupt();
         __no_operation();                         // For debugger
 
-        sendPacket();
-
-        data_received = 0;
-        buffer_pos = 0;
+#if FOUNTAIN
+        sendFountain();
+#elif ARQ
+        arqUpdate();
+#if RATE_ADAPT
+        rateUpdate();
+#endif
+        if (arqSelect()) {
+            sendPacket();
+        }
+#else
+        if (frames_ready) {
+            sendPacket();
+        }
+#endif
     }
 
     return 0;
@@ -142,16 +827,20 @@ __interrupt void USCI_A1_ISR(void)
     {
     case 0 : break;                 // Vector 0 - no interrupt
     case 2 :                        // Vector 2 - RXIFG9
+#if UART_ECHO
         while(!(UCA1IFG & UCTXIFG));
 
         UCA1TXBUF = UCA1RXBUF;
-        buffer[buffer_pos] = UCA1RXBUF;
-        CRC_set8BitData(CRC_BASE, buffer[buffer_pos]);        // Calculate CRC for this byte
-        buffer_pos++;
+#endif
 
-        if(buffer_pos == BUFFER_SIZE) {
-            UCA1IE &= ~UCRXIE;          // Disable USCI_A1 RX interrupts
-            __bic_SR_register_on_exit(LPM0_bits);
+        idle_polls = 0;
+        if (storeByte(UCA1RXBUF)) {
+            if (frames_ready == BUFFER_COUNT) {
+                UCA1IE &= ~UCRXIE;      // Every buffer waits for the LED, disable USCI_A1 RX interrupts
+            }
+            if (!sending) {
+                __bic_SR_register_on_exit(LPM0_bits);
+            }
         }
 
         break;
@@ -160,6 +849,146 @@ __interrupt void USCI_A1_ISR(void)
     }
 }
 
+#if ARQ
+// Ack byte from the receiver, only whole acks with a good check byte are kept
+#pragma vector=USCI_A0_VECTOR
+__interrupt void USCI_A0_ISR(void)
+{
+    switch(__even_in_range(UCA0IV, 4))
+    {
+    case 2 :                        // Vector 2 - RXIFG
+        arq_ack_bytes[arq_ack_pos] = UCA0RXBUF;
+        if (arq_ack_pos == 0 && arq_ack_bytes[0] != ARQ_ACK_MARK) {
+            break;                  // Wait for the start of an ack
+        }
+        arq_ack_pos++;
+        if (arq_ack_pos < ARQ_ACK_SIZE) {
+            break;
+        }
+        arq_ack_pos = 0;
+        if ((arq_ack_bytes[0] ^ arq_ack_bytes[1] ^ arq_ack_bytes[2] ^ arq_ack_bytes[3]) == arq_ack_bytes[4]) {
+            arq_ack_base = arq_ack_bytes[1];
+            arq_ack_bits = arq_ack_bytes[2];
+            arq_ack_last = arq_ack_bytes[3];
+            arq_ack_new = 1;
+            arq_polls = 0;
+            if (!sending) {
+                __bic_SR_register_on_exit(LPM0_bits);
+            }
+        }
+        break;
+    default : break;
+    }
+}
+#elif TDMA && !TDMA_MASTER
+// Beacon from the master, our superframe follows its own
+#pragma vector=USCI_A0_VECTOR
+__interrupt void USCI_A0_ISR(void)
+{
+    switch(__even_in_range(UCA0IV, 4))
+    {
+    case 2 :                        // Vector 2 - RXIFG
+        if (UCA0RXBUF == TDMA_BEACON) {
+            TA2R = 0;
+            tdma_polls = TDMA_BEACON_POLLS;     // The master started the superframe when the byte began
+            tdma_synced = 1;
+        }
+        break;
+    default : break;
+    }
+}
+#endif
+
+#if CSMA
+// Light while we listen, somebody else is sending
+#pragma vector=PORT2_VECTOR
+__interrupt void Port_2(void)
+{
+    csma_heard = 1;
+    P2IE &= ~BIT4;                  // Once is enough
+    P2IFG &= ~BIT4;
+}
+#endif
+
+// Timer2 A0 interrupt service routine
+// Only wakes the CPU when uart_ring holds enough to complete a buffer, or when the computer
+// stopped sending (idle line) and some bytes are still waiting or a buffer is partly filled.
+#pragma vector=TIMER2_A0_VECTOR
+__interrupt void TIMER2_A0_ISR(void)
+{
+#if TDMA
+    tdma_polls++;
+    if (tdma_polls >= TDMA_SLOTS * TDMA_SLOT_POLLS) {
+        tdma_polls = 0;
+#if TDMA_MASTER
+        UCA0TXBUF = TDMA_BEACON;    // Next superframe
+#endif
+    }
+    tdma_turn = tdma_synced && tdma_polls == TDMA_SLOT * TDMA_SLOT_POLLS;     // A frame only starts on the first poll of our slot
+    if (tdma_turn && sending) {
+        __bic_SR_register_on_exit(LPM0_bits);
+    }
+#endif
+#if CSMA
+    if (csma_polls != 0) {
+        csma_polls--;
+        if (csma_polls == 0) {
+            __bic_SR_register_on_exit(LPM0_bits);
+        }
+    }
+#endif
+#if ARQ
+    if (arq_next != arq_base && ++arq_polls >= ARQ_TIMEOUT) {
+        arq_polls = 0;
+        arq_timeout = 1;            // Frames or acks were lost and nothing else would tell us
+        if (!sending) {
+            __bic_SR_register_on_exit(LPM0_bits);
+        }
+    }
+#endif
+#if RATE_ADAPT
+    if (rate_idle_polls < RATE_IDLE_POLLS) {
+        rate_idle_polls++;
+    }
+#endif
+#if UART_RX_DMA
+    unsigned int head = (UART_RING_SIZE - DMA1SZ) % UART_RING_SIZE;
+    unsigned int pending;
+
+    // DMA1 writes far less than UART_RING_SIZE between two polls, so the move of the head is all new bytes
+    if (ring_unread <= UART_RING_SIZE) {
+        ring_unread += (head + UART_RING_SIZE - ring_last_head) % UART_RING_SIZE;
+    }
+    pending = ring_unread;
+
+    if (head != ring_last_head) {
+        idle_polls = 0;
+    }
+    else if (idle_polls < UART_IDLE_POLLS) {
+        idle_polls++;
+    }
+    ring_last_head = head;
+
+    if (!sending && ((pending != 0 && (pending >= BUFFER_FILL - buffer_pos || idle_polls != 0))
+                     || (UNSENT_BYTES && idle_polls == UART_IDLE_POLLS))) {
+        __bic_SR_register_on_exit(LPM0_bits);
+    }
+#else
+    if (idle_polls < UART_IDLE_POLLS) {
+        idle_polls++;
+        if (idle_polls == UART_IDLE_POLLS && UNSENT_BYTES) {
+            flushBuffers();                 // Idle line, send what we have
+            if (frames_ready == BUFFER_COUNT) {
+                UCA1IE &= ~UCRXIE;
+            }
+            if (!sending) {
+                __bic_SR_register_on_exit(LPM0_bits);
+            }
+        }
+    }
+#endif
+}
+
 // Timer0 A0 interrupt service routine
 #pragma vector=TIMER0_A0_VECTOR
 __interrupt void TIMER0_A0_ISR(void)
@@ -176,43 +1005,205 @@ __interrupt void TIMER0_A0_ISR(void)
 
 }
 
+// Timer1 A1 interrupt service routine
+// The edge of packet[tx_pos] has just been placed on P2.0 by the hardware, so there is
+// a full bit period to program the compare mode of the next one. When another interrupt
+// held this one back for longer, TA1R is already past the new TA1CCR1 and the edge would
+// only come when TA1R wraps round (65536 cycles): the frame is cut short instead.
+#pragma vector=TIMER1_A1_VECTOR
+__interrupt void TIMER1_A1_ISR(void)
+{
+    switch(__even_in_range(TA1IV, 14))
+    {
+    case 2 :                        // Vector 2 - CCR1
+        tx_pos++;
+        if (tx_pos < packet_length) {
+            TA1CCR1 += SYMBOL_PERIOD;
+            TA1CCTL1 = (packet[tx_pos] ? OUTMOD_5 : OUTMOD_1) + CCIE;     // LED is on when P2.0 is low
+            if ((int16_t)(TA1CCR1 - TA1R) <= 0) {
+                TA1CCTL1 = OUTMOD_0 + OUT;      // Too late for this edge, back to the idle level
+                tx_late = 1;
+                __bic_SR_register_on_exit(LPM0_bits);
+            }
+        }
+        else {
+            TA1CCTL1 = OUTMOD_0 + OUT;          // Stop bit is on the air, hold the idle level
+            sending = 0;
+            __bic_SR_register_on_exit(LPM0_bits);
+        }
+        break;
+    default : break;
+    }
+}
+
+// DMA interrupt service routine
+#pragma vector=DMA_VECTOR
+__interrupt void DMA_ISR(void)
+{
+    switch(__even_in_range(DMAIV, 16))
+    {
+    case 2 :                        // Vector 2 - DMA channel 0
+        TA0CTL &= ~MC_3;                        // Stop the symbol clock, P2OUT keeps the stop bit
+        sending = 0;
+        __bic_SR_register_on_exit(LPM0_bits);
+        break;
+    default : break;
+    }
+}
+
 void acquireData() {
     //Data will eventually come from the sensor
 }
 
-void sendPacket() {
+// Appends a byte from the computer to the buffer being filled. Returns 1 when it completes that buffer.
+char storeByte(char byte) {
 
-    sending = 1;
+    buffer[fill_index][HEADER_SIZE + ARQ_HEADER + buffer_pos] = byte;
+    buffer_pos++;
 
-    // start bit
-    __bis_SR_register(LPM0_bits + GIE);       // CPU off, enable interrupts
-                                              //always wait for the right time to acquire data
-    P2OUT = ~(0xFE | START_BIT);
+    if (buffer_pos < BUFFER_FILL) {
+        return 0;
+    }
 
-    // data bits
-    for (i = 0; i < BUFFER_SIZE * 8; i++) {
-        __bis_SR_register(LPM0_bits + GIE);       // CPU off, enable interrupts
-                                                  //always wait for the right time to acquire data
-        P2OUT = ~(0xFE | ((buffer[(int)(i/8)] >> i%8) & 1));
+    closeBuffer();
+    return 1;
+}
+
+// Hands the buffer being filled to sendPacket(), whatever its length
+void closeBuffer() {
+
+    buffer[fill_index][0] = ARQ_HEADER + buffer_pos;
+#if ADDRESSING
+    buffer[fill_index][1] = DESTINATION;
+#endif
+#if ARQ
+    buffer[fill_index][HEADER_SIZE] = arq_fill_seq++;
+#endif
+    buffer_pos = 0;
+    fill_index = (fill_index + 1) % BUFFER_COUNT;
+    frames_ready++;
+}
+
+// Moves what DMA1 wrote in uart_ring since last time to the frame buffers
+void readUartRing() {
+
+    unsigned int unread, taken = 0;
+
+    // With every buffer full the ring isn't read. Once DMA1 went round onto bytes not taken
+    // yet, the ring holds new bytes in the middle of old ones: drop them all instead of
+    // sending them mixed up.
+    __disable_interrupt();
+    if (ring_unread > UART_RING_SIZE) {
+        ring_tail = ring_last_head;
+        ring_unread = 0;
+        uart_overruns++;
     }
+    unread = ring_unread;
+    __enable_interrupt();
 
-    // checksum
-    crc checksum = (crc)CRC_getResult(CRC_BASE);
-    for (i = 0; i < sizeof(crc) * 8; i++) {
-        __bis_SR_register(LPM0_bits + GIE);       // CPU off, enable interrupts
-                                                  //always wait for the right time to acquire data
-        P2OUT = ~(0xFE | ((checksum >> i) & 1));
+    while (taken != unread && frames_ready < BUFFER_COUNT) {
+#if UART_ECHO
+        while(!(UCA1IFG & UCTXIFG));
+        UCA1TXBUF = uart_ring[ring_tail];
+#endif
+        storeByte(uart_ring[ring_tail]);
+        ring_tail = (ring_tail + 1) % UART_RING_SIZE;
+        taken++;
+    }
+
+    __disable_interrupt();
+    ring_unread -= taken;
+    unread = ring_unread;
+    __enable_interrupt();
+
+    if (unread == 0 && UNSENT_BYTES
+            && idle_polls == UART_IDLE_POLLS && frames_ready < BUFFER_COUNT) {
+        flushBuffers();             // Idle line, send what we have
     }
+}
 
+// Closes the partly filled buffer. A fountain block is completed with empty buffers.
+void flushBuffers() {
 
-    // stop bit
-    __bis_SR_register(LPM0_bits + GIE);       // CPU off, enable interrupts
-                                              //always wait for the right time to acquire data
-    P2OUT = ~(0xFE & STOP_BIT);
+    if (buffer_pos != 0) {
+        closeBuffer();
+    }
+#if FOUNTAIN
+    while (frames_ready % FOUNTAIN_K != 0) {
+        closeBuffer();
+    }
+#endif
+}
 
-    CRC_setSeed(CRC_BASE, 0x0000);            // Reset CRC signature
-    UCA1IFG &= ~UCRXIFG;                      // Clear RX interrupt flag
-    UCA1IE |= UCRXIE;                         // Enable USCI_A1 RX interrupts
+void sendPacket() {
+
+#if TX_ENGINE == TX_TIMER
+    unsigned int retries;
+#endif
+
+    sending = 1;
+
+    buildPacket();
+
+#if TDMA
+    __disable_interrupt();
+    while (!tdma_turn) {
+        __bis_SR_register(LPM0_bits + GIE);       // CPU off until our slot, the frame is ready to go
+        __disable_interrupt();
+    }
+    __enable_interrupt();
+#endif
+#if CSMA
+    listenBeforeTalk();
+#endif
+
+#if TX_ENGINE == TX_TIMER
+    for (retries = 0; ; retries++) {
+        tx_late = 0;
+        startTimerTransmit();
+        __disable_interrupt();
+        while (sending && !tx_late) {
+            __bis_SR_register(LPM0_bits + GIE);   // CPU off until the stop bit has been placed
+            __disable_interrupt();
+        }
+        __enable_interrupt();
+        if (!tx_late) {
+            break;
+        }
+        if (retries == TX_RETRIES) {
+            tx_late_frames++;                     // The receiver drops what it got of it, ARQ would resend it
+            break;
+        }
+    }
+#elif TX_ENGINE == TX_DMA
+    startDmaTransmit();
+    __disable_interrupt();
+    while (sending) {
+        __bis_SR_register(LPM0_bits + GIE);       // CPU off until the stop bit has been placed
+        __disable_interrupt();
+    }
+    __enable_interrupt();
+#else
+    for (i = 0; i < packet_length; i++) {
+        __bis_SR_register(LPM0_bits + GIE);       // CPU off, enable interrupts
+                                                  //always wait for the right time to acquire data
+#if PULSE_AMPLITUDE
+        TB0CCR2 = packet[i];
+#else
+        P2OUT = ~(0xFE | packet[i]);
+#endif
+    }
+#endif
+
+#if !FOUNTAIN && !ARQ
+    send_index = (send_index + 1) % BUFFER_COUNT;
+    __disable_interrupt();
+    frames_ready--;
+#if !UART_RX_DMA
+    UCA1IE |= UCRXIE;                         // A buffer is free again, enable USCI_A1 RX interrupts
+#endif
+    __enable_interrupt();
+#endif
 
 /*
     char test = 0;
@@ -234,7 +1225,735 @@ void sendPacket() {
     sending = 0;
 }
 
+#if CSMA
+// Returns once the light stayed dark for CSMA_LISTEN_POLLS. Every busy look waits a random number of polls,
+// drawn in a window that doubles each time, so that senders waiting for the same frame don't start together.
+void listenBeforeTalk() {
+
+    unsigned int window = CSMA_MIN_WINDOW;
+
+    while (1) {
+        csma_heard = 0;
+        P2IFG &= ~BIT4;
+        P2IE |= BIT4;
+        waitPolls(CSMA_LISTEN_POLLS);
+        P2IE &= ~BIT4;
+        if (!csma_heard && !(P2IN & BIT4)) {
+            return;
+        }
+
+        csma_busy++;
+        waitPolls(1 + csmaRandom() % window);
+        if (window < CSMA_MAX_WINDOW) {
+            window *= 2;
+        }
+    }
+}
+
+void waitPolls(unsigned int polls) {
+
+    __disable_interrupt();
+    csma_polls = polls;
+    while (csma_polls != 0) {
+        __bis_SR_register(LPM0_bits + GIE);       // CPU off, TIMER2_A0 counts the polls
+        __disable_interrupt();
+    }
+    __enable_interrupt();
+}
+
+unsigned int csmaRandom() {
+
+    csma_random = csma_random * 25173u + 13849u;
+    return csma_random >> 8;
+}
+#endif
+
+#if FOUNTAIN
+// Sends one LT coded symbol of the block on the air. Nobody tells us which frames got through, so the
+// block stays on the air until it had FOUNTAIN_SYMBOLS frames and the next block is full.
+void sendFountain() {
+
+    unsigned int mask, source, pos;
+
+    if (fountain_active && fountain_id >= FOUNTAIN_SYMBOLS && frames_ready >= 2 * FOUNTAIN_K) {
+        send_index = (send_index + FOUNTAIN_K) % BUFFER_COUNT;
+        __disable_interrupt();
+        frames_ready -= FOUNTAIN_K;
+#if !UART_RX_DMA
+        UCA1IE |= UCRXIE;                     // A block is free again, enable USCI_A1 RX interrupts
+#endif
+        __enable_interrupt();
+        fountain_active = 0;
+    }
+    if (!fountain_active) {
+        if (frames_ready < FOUNTAIN_K) {
+            return;
+        }
+        fountain_active = 1;
+        fountain_block++;
+        fountain_id = 0;
+    }
+
+    fountain_frame[0] = FOUNTAIN_HEADER + FOUNTAIN_SYMBOL_SIZE;
+#if ADDRESSING
+    fountain_frame[1] = DESTINATION;
+#endif
+    fountain_frame[HEADER_SIZE] = fountain_block;
+    fountain_frame[HEADER_SIZE + 1] = fountain_id;
+    fountain_frame[HEADER_SIZE + 2] = fountain_id >> 8;
+    for (pos = 0; pos < FOUNTAIN_SYMBOL_SIZE; pos++) {
+        fountain_frame[HEADER_SIZE + FOUNTAIN_HEADER + pos] = 0;
+    }
+
+    mask = fountainNeighbours(fountain_id);
+    for (source = 0; source < FOUNTAIN_K; source++) {
+        if (mask & (1u << source)) {
+            for (pos = 0; pos < FOUNTAIN_SYMBOL_SIZE; pos++) {
+                fountain_frame[HEADER_SIZE + FOUNTAIN_HEADER + pos] ^= buffer[send_index + source][pos];
+            }
+        }
+    }
+
+    sendPacket();
+    fountain_id++;
+}
+
+// Robust soliton degree distribution (Luby), the receiver builds the same table
+void fountainInit() {
+
+    double spread = FOUNTAIN_C * log(FOUNTAIN_K / FOUNTAIN_DELTA) * sqrt(FOUNTAIN_K);
+    double total = 0, sum = 0;
+    unsigned int spike = (unsigned int)(FOUNTAIN_K / spread + 0.5);
+    unsigned int degree;
+
+    if (spike < 1) {
+        spike = 1;
+    }
+    if (spike > FOUNTAIN_K) {
+        spike = FOUNTAIN_K;
+    }
+    for (degree = 1; degree <= FOUNTAIN_K; degree++) {
+        total += solitonWeight(degree, spread, spike);
+    }
+    for (degree = 1; degree <= FOUNTAIN_K; degree++) {
+        sum += solitonWeight(degree, spread, spike);
+        fountain_cdf[degree - 1] = (unsigned int)(sum / total * 65535.0 + 0.5);
+    }
+    fountain_cdf[FOUNTAIN_K - 1] = 65535;
+}
+
+double solitonWeight(unsigned int degree, double spread, unsigned int spike) {
+
+    double weight = (degree == 1) ? 1.0 / FOUNTAIN_K : 1.0 / (degree * (degree - 1.0));
+
+    if (degree < spike) {
+        weight += spread / (degree * (double)FOUNTAIN_K);
+    }
+    else if (degree == spike) {
+        weight += spread * log(spread / FOUNTAIN_DELTA) / FOUNTAIN_K;
+    }
+    return weight;
+}
+
+// xorshift16, never gives 0 from a state other than 0
+unsigned int fountainRandom() {
+
+    fountain_random ^= fountain_random << 7;
+    fountain_random ^= fountain_random >> 9;
+    fountain_random ^= fountain_random << 8;
+    return fountain_random;
+}
+
+// Buffers combined in coded symbol id (bit j = buffer j of the block), the same on both sides
+unsigned int fountainNeighbours(unsigned int id) {
 
+    unsigned int mask = 0, degree = 1, index, draw;
+
+    if (id < FOUNTAIN_K) {
+        return 1u << id;            // The first ones go out as they are, nothing to decode without losses
+    }
+
+    fountain_random = id * 0x9E37u;             // Odd, consecutive ids start far apart
+    fountainRandom();
+    draw = fountainRandom();
+    while (degree < FOUNTAIN_K && fountain_cdf[degree - 1] < draw) {
+        degree++;
+    }
+    while (degree--) {
+        index = fountainRandom() % FOUNTAIN_K;
+        while (mask & (1u << index)) {
+            index = (index + 1) % FOUNTAIN_K;
+        }
+        mask |= 1u << index;
+    }
+    return mask;
+}
+#endif
+
+#if ARQ
+// Applies the last ack: buffers up to the receiver's next expected number are free again, the ones
+// it doesn't have although it got a frame sent after them go again. A timeout sends all unacked ones again.
+void arqUpdate() {
+
+    unsigned char base, bits, last, seq, slot, offset;
+
+    __disable_interrupt();
+    char fresh = arq_ack_new;
+    base = arq_ack_base;
+    bits = arq_ack_bits;
+    last = arq_ack_last;
+    arq_ack_new = 0;
+    char timeout = arq_timeout;
+    arq_timeout = 0;
+    __enable_interrupt();
+
+    if (fresh && (unsigned char)(base - arq_base) <= (unsigned char)(arq_next - arq_base)
+            && (unsigned char)(last - arq_base) < (unsigned char)(arq_next - arq_base)) {
+#if RATE_ADAPT
+        rate_timeouts = 0;
+#endif
+        while (arq_base != base) {
+            slot = arq_base % ARQ_WINDOW;
+            arq_acked &= ~(1 << slot);
+            arq_resend &= ~(1 << slot);
+            arq_base++;
+            __disable_interrupt();
+            frames_ready--;
+#if !UART_RX_DMA
+            UCA1IE |= UCRXIE;                 // A buffer is free again, enable USCI_A1 RX interrupts
+#endif
+            __enable_interrupt();
+        }
+
+        for (offset = 0; offset < ARQ_WINDOW && offset < (unsigned char)(arq_next - arq_base); offset++) {
+            seq = arq_base + offset;
+            slot = seq % ARQ_WINDOW;
+            if (bits & (1 << offset)) {
+                arq_acked |= 1 << slot;
+                arq_resend &= ~(1 << slot);
+            }
+            else if ((signed char)(arq_stamp[slot] - arq_stamp[last % ARQ_WINDOW]) < 0) {
+                arq_resend |= 1 << slot;        // Sent before the frame that got through, so it was lost
+            }
+        }
+    }
+
+    if (timeout) {
+#if RATE_ADAPT
+        rate_timeouts++;
+#endif
+        for (seq = arq_base; seq != arq_next; seq++) {
+            slot = seq % ARQ_WINDOW;
+            if (!(arq_acked & (1 << slot))) {
+                arq_resend |= 1 << slot;
+            }
+        }
+    }
+}
+
+// Chooses the buffer for the LED: the oldest one to send again, else the first one never sent. Returns 0 if there is none.
+char arqSelect() {
+
+    unsigned char seq, slot;
+
+    for (seq = arq_base; seq != arq_next; seq++) {
+        slot = seq % ARQ_WINDOW;
+        if (arq_resend & (1 << slot)) {
+            arq_resend &= ~(1 << slot);
+#if RATE_ADAPT
+            rate_resent++;
+#endif
+            break;
+        }
+    }
+    if (seq == arq_next) {
+        if ((unsigned char)(arq_next - arq_base) == frames_ready) {
+            return 0;
+        }
+        slot = arq_next % ARQ_WINDOW;
+        arq_next++;
+    }
+
+    send_index = slot;
+    arq_stamp[slot] = arq_sent++;
+    arq_polls = 0;
+#if RATE_ADAPT
+    rate_sent++;
+    rate_idle_polls = 0;
+#endif
+    return 1;
+}
+#endif
+
+#if RATE_ADAPT
+// Picks the rate from the resends of the last RATE_WINDOW frames. The receiver hears of a change through
+// link frames sent at the old rate. If they are all lost, the timeouts (and its own silence) bring both boards
+// back to TIMER_COUNTER.
+void rateUpdate() {
+
+    unsigned char next = link_rate;
+    unsigned int copy;
+
+    if (link_rate == 0) {
+        // Nothing slower to go to
+    }
+    else if (rate_idle_polls >= RATE_IDLE_POLLS) {
+        next = 0;                       // The receiver may have gone back already
+    }
+    else if (rate_timeouts >= RATE_FALLBACK) {
+        next = 0;                       // Not a single ack, the receiver can't hear us
+    }
+    else if (rate_resent >= RATE_DOWN_RESENDS) {
+        next = link_rate - 1;           // No need to wait for the end of the window
+        rate_failed = link_rate;
+        rate_hold = RATE_HOLD;
+    }
+    if (next == link_rate && rate_sent >= RATE_WINDOW) {
+        if (rate_resent <= RATE_UP_RESENDS && link_rate < RATE_STEPS) {
+            if (link_rate + 1 == rate_failed && rate_hold != 0) {
+                rate_hold--;
+            }
+            else {
+                next = link_rate + 1;
+            }
+        }
+        rate_sent = 0;
+        rate_resent = 0;
+    }
+    if (next == link_rate) {
+        return;
+    }
+
+    link_frame[0] = LINK_SIZE;
+#if ADDRESSING
+    link_frame[1] = DESTINATION;
+#endif
+    link_frame[HEADER_SIZE] = next;
+    link_sending = 1;
+    for (copy = 0; copy < LINK_COPIES; copy++) {
+        link_frame[HEADER_SIZE + 1] = LINK_COPIES - 1 - copy;      // The receiver switches after the one with 0
+        sendPacket();
+    }
+    link_sending = 0;
+    setRate(next);
+}
+
+// Every symbol timing follows SYMBOL_PERIOD, only the registers loaded once need it again
+void setRate(unsigned char rate) {
+
+    link_rate = rate;
+    rate_sent = 0;
+    rate_resent = 0;
+    rate_timeouts = 0;
+    rate_idle_polls = 0;
+#if TX_ENGINE == TX_DMA
+    TA0CCR0 = SYMBOL_PERIOD - 1;
+#endif
+}
+#endif
+
+// Expands the whole frame into packet[] as line symbols. With TX_DMA every
+// symbol is already the P2OUT image so that the DMA can copy it to the port without any CPU help.
+void buildPacket() {
+
+    unsigned int pos;
+
+    packet_length = 0;
+    line_level = 0;                 // Idle, LED off
+    group = 0;
+    group_fill = 0;
+    disparity = 0;
+
+    putBit(START_BIT);
+
+    for (pos = 0; pos < PREAMBLE_BITS; pos++) {
+        putBit(!(pos & 1) ^ START_BIT);             // Keep alternating after the start bit
+    }
+
+#if RATE_ADAPT
+    sync_word sync = link_sending ? LINK_SYNC_WORD : SYNC_WORD;
+#else
+    sync_word sync = SYNC_WORD;
+#endif
+    for (pos = 0; pos < SYNC_BITS; pos++) {
+        putBit((sync >> pos) & 1);
+    }
+
+#if PULSE_AMPLITUDE
+    for (pos = 0; pos < TRAINING_SYMBOLS; pos++) {
+        packet[packet_length++] = LEVEL(pos & (PAM_LEVELS - 1));     // Every level in turn, the receiver sets its thresholds on them
+    }
+#endif
+
+#if FOUNTAIN
+    char *frame = fountain_frame;
+#elif RATE_ADAPT
+    char *frame = link_sending ? link_frame : buffer[send_index];
+#else
+    char *frame = buffer[send_index];
+#endif
+    unsigned int length = HEADER_SIZE + (unsigned char)frame[0];
+    putHeader(frame);
+    startInterleaver();
+    scrambler_state = SCRAMBLER_SEED;
+    for (pos = HEADER_SIZE; pos < length; pos++) {
+        putCodedByte(scramble(frame[pos]));
+    }
+
+    crc checksum = calculateChecksum(frame, length);
+    for (pos = 0; pos < sizeof(crc); pos++) {
+        putCodedByte(scramble(checksum >> (pos * 8)));
+    }
+
+    putParity();
+    putInterleaved();
+    flushGroup();
+
+    putBit(STOP_BIT);
+
+    if (line_level != 0) {
+        packet[packet_length++] = SYMBOL(0);        // Give the LED back to the idle level
+    }
+#if FEC == FEC_REED_SOLOMON
+    putDecodeGap(length);
+#endif
+}
+
+void putByte(char byte) {
+
+    unsigned int bit;
+    for (bit = 0; bit < 8; bit++) {
+        putCodeBit((byte >> bit) & 1);
+    }
+}
+
+// Every bit is xored with the scrambled bits 6 and 7 before it, a whole byte per table step
+char scramble(char byte) {
+
+#if SCRAMBLER
+    unsigned char scrambled = scramble_input[(unsigned char)byte] ^ scramble_history[scrambler_state];
+
+    scrambler_state = (unsigned char)((scrambler_state | ((unsigned int)scrambled << 7)) >> 8);
+    return scrambled;
+#else
+    return byte;
+#endif
+}
+
+// Byte protected by the selected error correction
+void putCodedByte(char byte) {
+
+#if FEC == FEC_HAMMING
+    putByte(hamming_encode[byte & 0x0F]);
+    putByte(hamming_encode[(byte >> 4) & 0x0F]);
+#elif FEC == FEC_REED_SOLOMON
+    putByte(byte);
+    rsEncode(byte);
+#elif FEC == FEC_CONVOLUTIONAL
+    unsigned int bit;
+    for (bit = 0; bit < 8; bit++) {
+        putConvBit((byte >> bit) & 1);
+    }
+#else
+    putByte(byte);
+#endif
+}
+
+// Payload length, opens the codeword
+void putHeader(char const *header) {
+
+    unsigned int pos;
+#if FEC == FEC_REED_SOLOMON || FEC == FEC_CONVOLUTIONAL
+    unsigned int copy;
+#if FEC == FEC_REED_SOLOMON
+    for (copy = 0; copy < RS_PARITY; copy++) {
+        rs_parity[copy] = 0;
+    }
+    for (pos = 0; pos < HEADER_SIZE; pos++) {
+        rsEncode(header[pos]);
+    }
+#else
+    conv_state = 0;
+#endif
+    for (pos = 0; pos < HEADER_SIZE; pos++) {
+        for (copy = 0; copy < HEADER_COPIES; copy++) {
+            putByte(header[pos]);
+        }
+    }
+#else
+    for (pos = 0; pos < HEADER_SIZE; pos++) {
+        putCodedByte(header[pos]);
+    }
+#endif
+}
+
+// Closes the codeword
+void putParity() {
+
+#if FEC == FEC_REED_SOLOMON || FEC == FEC_CONVOLUTIONAL
+    unsigned int pos;
+#endif
+#if FEC == FEC_REED_SOLOMON
+    for (pos = 0; pos < RS_PARITY; pos++) {
+        putByte(rs_parity[pos]);
+    }
+#elif FEC == FEC_CONVOLUTIONAL
+    for (pos = 0; pos < CONV_K - 1; pos++) {
+        putConvBit(0);              // Tail, brings the encoder back to state 0
+    }
+#endif
+}
+
+#if FEC == FEC_REED_SOLOMON
+// The receiver corrects a Reed-Solomon codeword after its stop bit, with the LED off. Idle symbols
+// hold the next start bit back until the longest correction of a frame of that length is done.
+void putDecodeGap(unsigned int length) {
+
+    unsigned long cycles = RS_DECODE_CYCLES(length + sizeof(crc) + RS_PARITY);
+    unsigned int pos;
+
+    for (pos = 0; pos < (cycles + SYMBOL_PERIOD - 1) / SYMBOL_PERIOD; pos++) {
+        packet[packet_length++] = SYMBOL(0);
+    }
+}
+
+// GF(256) arithmetic, primitive polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11D)
+unsigned char gfMul(unsigned char a, unsigned char b) {
+
+    if (a == 0 || b == 0) {
+        return 0;
+    }
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+// Computes the generator polynomial, (x + 1)(x + a)...(x + a^(RS_PARITY-1)), coefficient of x^j in rs_generator[j]
+void rsInit() {
+
+    unsigned int i, j;
+
+    rs_generator[0] = 1;
+    for (j = 1; j <= RS_PARITY; j++) {
+        rs_generator[j] = 0;
+    }
+    for (i = 0; i < RS_PARITY; i++) {
+        for (j = i + 1; j > 0; j--) {
+            rs_generator[j] = rs_generator[j - 1] ^ gfMul(rs_generator[j], gf_exp[i]);
+        }
+        rs_generator[0] = gfMul(rs_generator[0], gf_exp[i]);
+    }
+}
+
+// Adds a sent byte to the parity (remainder of the division by the generator polynomial)
+void rsEncode(unsigned char byte) {
+
+    unsigned char feedback = byte ^ rs_parity[0];
+    unsigned int j;
+
+    for (j = 0; j < RS_PARITY - 1; j++) {
+        rs_parity[j] = rs_parity[j + 1] ^ gfMul(feedback, rs_generator[RS_PARITY - 1 - j]);
+    }
+    rs_parity[RS_PARITY - 1] = gfMul(feedback, rs_generator[0]);
+}
+#endif
+
+#if FEC == FEC_CONVOLUTIONAL
+// Even parity of the bits of value
+char parity(unsigned int value) {
+
+    value ^= value >> 8;
+    value ^= value >> 4;
+    value ^= value >> 2;
+    value ^= value >> 1;
+    return value & 1;
+}
+
+// Shifts a bit in the encoder, two coded bits come out
+void putConvBit(char bit) {
+
+    conv_state = ((conv_state << 1) | bit) & (2 * CONV_STATES - 1);
+    putCodeBit(parity(conv_state & CONV_POLY_A));
+    putCodeBit(parity(conv_state & CONV_POLY_B));
+}
+#endif
+
+// Output of the error correction, kept aside while the interleaver is on
+void putCodeBit(char bit) {
+
+    if (interleaving) {
+        if (bit) {
+            coded_bits[code_pos >> 3] |= 1 << (code_pos & 7);
+        }
+        else {
+            coded_bits[code_pos >> 3] &= ~(1 << (code_pos & 7));
+        }
+        code_pos++;
+    }
+    else {
+        putDataBit(bit);
+    }
+}
+
+// Everything after the length goes through the interleaver
+void startInterleaver() {
+
+    code_pos = 0;
+    interleaving = (INTERLEAVE_ROWS > 1);
+}
+
+// Sends the kept coded bits column by column
+void putInterleaved() {
+
+    unsigned int pos, index;
+
+    if (!interleaving) {
+        return;
+    }
+    interleaving = 0;
+
+    interleaverStart(code_pos);
+    for (pos = 0; pos < code_pos; pos++) {
+        index = interleaverNext();
+        putDataBit((coded_bits[index >> 3] >> (index & 7)) & 1);
+    }
+}
+
+// Rows of il_columns bits, the last one may be short (same as the receiver)
+void interleaverStart(unsigned int bits) {
+
+    il_bits = bits;
+    il_columns = (bits + INTERLEAVE_ROWS - 1) / INTERLEAVE_ROWS;
+    il_column = 0;
+    il_row = 0;
+    il_index = 0;
+}
+
+// Codeword position of the next bit on the air
+unsigned int interleaverNext() {
+
+    unsigned int index = il_index;
+
+    il_row++;
+    il_index += il_columns;
+    if (il_row == INTERLEAVE_ROWS || il_index >= il_bits) {
+        il_column++;                // Next column, from the top
+        il_row = 0;
+        il_index = il_column;
+    }
+    return index;
+}
+
+// Header and block bits, gathered in groups for the block line codes
+void putDataBit(char bit) {
+
+#if GROUP_BITS > 1
+    group |= (unsigned int)bit << group_fill;
+    group_fill++;
+    if (group_fill == GROUP_BITS) {
+        putGroup();
+    }
+#else
+    putBit(bit);
+#endif
+}
+
+// Sends a full group as its code, first symbol = bit 0 of the code
+void putGroup() {
+
+#if GROUP_BITS > 1
+#if !PULSE_AMPLITUDE
+    unsigned int pos;
+#endif
+#if !PULSE_POSITION && !PULSE_AMPLITUDE
+    unsigned int code;
+#endif
+
+#if LINE_CODE == LINE_4B5B
+    code = line_4b5b[group];
+    for (pos = 0; pos < GROUP_SYMBOLS; pos++) {
+        if ((code >> pos) & 1) {
+            line_level ^= 1;        // NRZI, a 1 is an edge
+        }
+        packet[packet_length++] = SYMBOL(line_level);
+    }
+#elif PULSE_AMPLITUDE
+    line_level = group ^ (group >> 1);             // Level whose Gray code gives the bits, a
+    line_level ^= line_level >> 2;                  // neighbouring level is only one wrong bit
+    packet[packet_length++] = LEVEL(line_level);
+#elif PULSE_POSITION
+    for (pos = 0; pos < GROUP_SYMBOLS; pos++) {
+        line_level = (pos == group);                // One pulse, in the slot given by the bits
+        packet[packet_length++] = SYMBOL(line_level);
+    }
+#else
+    unsigned int x = group & 0x1F, y = group >> 5;
+    unsigned char low, high;
+
+    low = line_5b6b[disparity][x];
+    if (low & 0x40) {
+        disparity ^= 1;             // Unbalanced sub-block
+    }
+    if (y == 7 && (disparity ? (x == 11 || x == 13 || x == 14) : (x == 17 || x == 18 || x == 20))) {
+        y = 8;                      // A7 instead of P7, no run of 5 across the sub-blocks
+    }
+    high = line_3b4b[disparity][y];
+    if (high & 0x10) {
+        disparity ^= 1;
+    }
+    code = (low & 0x3F) | ((unsigned int)(high & 0x0F) << 6);
+    for (pos = 0; pos < GROUP_SYMBOLS; pos++) {
+        line_level = (code >> pos) & 1;
+        packet[packet_length++] = SYMBOL(line_level);
+    }
+#endif
+    group = 0;
+    group_fill = 0;
+#endif
+}
+
+// Pads the last group with zeros
+void flushGroup() {
+
+    if (group_fill) {
+        putGroup();
+    }
+}
+
+// Framing bits, and every bit when there is no block line code
+void putBit(char bit) {
+
+#if SYMBOLS_PER_BIT == 1
+    line_level = bit;
+    packet[packet_length++] = SYMBOL(line_level);
+#elif LINE_CODE == LINE_MANCHESTER
+    packet[packet_length++] = SYMBOL(!bit);
+    line_level = bit;
+    packet[packet_length++] = SYMBOL(line_level);
+#else
+    if (bit == 0) {
+        line_level ^= 1;            // Transition at the start of a 0
+    }
+    packet[packet_length++] = SYMBOL(line_level);
+    line_level ^= 1;                // Transition in the middle of every bit
+    packet[packet_length++] = SYMBOL(line_level);
+#endif
+}
+
+void startTimerTransmit() {
+
+    tx_pos = 0;
+    TA1CCR1 = TA1R + SYMBOL_PERIOD;                         // Start bit edge one symbol from now
+    TA1CCTL1 = (packet[0] ? OUTMOD_5 : OUTMOD_1) + CCIE;    // Hardware sets/resets P2.0 on the compare
+}
+
+void startDmaTransmit() {
+
+    DMA_setTransferSize(DMA_CHANNEL_0, packet_length);
+    DMA_enableTransfers(DMA_CHANNEL_0);     // Source address is reloaded after every frame
+    TA0CTL = TASSEL_2 + MC_1 + TACLR;       // First symbol is copied one period from now
+}
+
+
+#if CRC_TYPE == CRC_32
 void crcInit(void)
 {
     crc remainder;
@@ -248,7 +1967,7 @@ void crcInit(void)
         /*
          * Start with the dividend followed by zeros.
          */
-        remainder = dividend << (WIDTH - 8);
+        remainder = (crc)dividend << (WIDTH - 8);
 
         /*
          * Perform modulo-2 division, a bit at a time.
@@ -276,13 +1995,26 @@ void crcInit(void)
     }
 
 }   /* crcInit() */
+#endif
 
 
 
+// CRC of a frame buffer, with the same settings as the receiver
 crc calculateChecksum(char const message[], int nBytes)
 {
-    char data;
-    crc remainder = 0;
+#if CRC_TYPE == CRC_16
+    CRC_setSeed(CRC_BASE, CRC_SEED);
+    DMA_setSrcAddress(DMA_CHANNEL_2, (uint32_t)(uintptr_t)message, DMA_DIRECTION_INCREMENT);
+    DMA_setTransferSize(DMA_CHANNEL_2, nBytes);
+    DMA_enableTransfers(DMA_CHANNEL_2);
+    DMA_startTransfer(DMA_CHANNEL_2);                   // The CPU is held while the block is copied
+    while (DMA_getInterruptStatus(DMA_CHANNEL_2) == DMA_INT_INACTIVE);
+    DMA_clearInterrupt(DMA_CHANNEL_2);
+
+    return CRC_getResult(CRC_BASE);
+#else
+    unsigned char data;
+    crc remainder = ~(crc)0;                            // CRC-32/MPEG-2: non-reflected, all ones seed
 
 
     /*
@@ -298,6 +2030,6 @@ crc calculateChecksum(char const message[], int nBytes)
      * The final remainder is the CRC.
      */
     return (remainder);
-
+#endif
 }
 
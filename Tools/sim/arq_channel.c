@@ -0,0 +1,160 @@
+// ARQ goodput of the boards over a lossy channel.
+//
+// The sender and the receiver are built with ARQ, their real arqUpdate(), arqSelect(),
+// arqReceive() and UART ISRs run. The light link and the ack line are replaced by a channel
+// that loses every frame and every ack with the same probability, the line code and the
+// crc are left out: a frame either comes whole or not at all.
+//
+// Time goes in TA2 UART polls (~1 ms) of the sender, the clock of ARQ_TIMEOUT. A frame of
+// BUFFER_SIZE bytes is about 6 polls on the air at TIMER_COUNTER 480, an ack of
+// ARQ_ACK_SIZE bytes at ARQ_BAUD_RATE 9600 about 6 more.
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <msp430.h>
+#include "sim.h"
+
+#define FRAME_POLLS   6                 // Frame on the air
+#define ACK_POLLS     6                 // Ack on the wire
+#define FRAMES        3000
+#define FILL          31                // BUFFER_FILL of the sender: BUFFER_SIZE - ARQ_HEADER
+#define FRAME_BYTES   33                // HEADER_SIZE + BUFFER_SIZE
+#define ACK_BYTES     5                 // ARQ_ACK_SIZE
+#define MAX_ACKS      64
+
+extern int tx_main(void);
+extern char tx_storeByte(char byte);
+extern void tx_arqUpdate(void);
+extern char tx_arqSelect(void);
+extern void tx_USCI_A0_ISR(void);
+extern void tx_TIMER2_A0_ISR(void);
+extern char tx_buffer[][FRAME_BYTES];
+extern volatile unsigned int tx_send_index, tx_frames_ready;
+extern unsigned char tx_arq_sent;
+
+extern int rx_main(void);
+extern void rx_arqReceive(void);
+extern char rx_buffer[];
+extern unsigned int rx_frame_length;
+extern unsigned char rx_arq_ack_next[];
+extern volatile char rx_arq_ack_due;
+
+static jmp_buf init_done;
+
+// Acks on the way back, with the poll they arrive at
+static unsigned char acks[MAX_ACKS][ACK_BYTES];
+static unsigned long ack_time[MAX_ACKS];
+static unsigned int ack_count;
+
+static void idleInit(void) {
+
+    longjmp(init_done, 1);              // main() is set up and waits
+}
+
+static int lost(double loss) {
+
+    return (double)rand() / RAND_MAX < loss;
+}
+
+static unsigned char sentByte(unsigned long n) {
+
+    return n * 7 + n / FILL;
+}
+
+// Ack bytes that arrived by now go through the UCA0 RX interrupt of the sender
+static void deliverAcks(unsigned long now) {
+
+    unsigned int k = 0, b;
+
+    while (k < ack_count) {
+        if (ack_time[k] > now) {
+            k++;
+            continue;
+        }
+        for (b = 0; b < ACK_BYTES; b++) {
+            UCA0IV = 2;
+            UCA0RXBUF = acks[k][b];
+            tx_USCI_A0_ISR();
+        }
+        ack_count--;
+        memmove(acks[k], acks[k + 1], (ack_count - k) * ACK_BYTES);
+        memmove(&ack_time[k], &ack_time[k + 1], (ack_count - k) * sizeof(ack_time[0]));
+    }
+}
+
+static void run(double loss) {
+
+    unsigned long total = (unsigned long)FRAMES * FILL, fed = 0, sent = 0, now = 0, bad = 0, n;
+    unsigned int poll;
+    char *frame;
+
+    sim_idle = idleInit;
+    if (!setjmp(init_done)) {
+        tx_main();
+    }
+    if (!setjmp(init_done)) {
+        rx_main();
+    }
+    sim_idle = NULL;
+    stub_sr = GIE;
+    uart_n = 0;
+    ack_count = 0;
+
+    while (uart_n < total && now < 10000000) {
+        while (fed < total && tx_frames_ready < 8) {
+            tx_storeByte(sentByte(fed++));
+        }
+        deliverAcks(now);
+
+        tx_arqUpdate();
+        if (!tx_arqSelect()) {
+            tx_TIMER2_A0_ISR();         // Waits for acks or for ARQ_TIMEOUT
+            now++;
+            continue;
+        }
+
+        sent++;
+        frame = tx_buffer[tx_send_index];
+        if (!lost(loss)) {
+            memcpy(rx_buffer, frame, FRAME_BYTES);
+            rx_frame_length = (unsigned char)frame[0];
+            rx_arqReceive();
+            if (rx_arq_ack_due) {
+                rx_arq_ack_due = 0;
+                if (!lost(loss) && ack_count < MAX_ACKS) {
+                    memcpy(acks[ack_count], rx_arq_ack_next, ACK_BYTES);
+                    ack_time[ack_count++] = now + FRAME_POLLS + ACK_POLLS;
+                }
+            }
+        }
+        for (poll = 0; poll < FRAME_POLLS; poll++) {
+            tx_TIMER2_A0_ISR();
+            now++;
+        }
+    }
+
+    for (n = 0; n < uart_n && n < total; n++) {
+        bad += uart_sink[n] != sentByte(n);
+    }
+    printf("%5.0f%% %12lu %10s %10.3f %10.3f %10.3f\n", 100 * loss, sent,
+           uart_n < total ? "STALLED" : bad ? "CORRUPT" : "in order",
+           (double)FRAMES / sent, (double)FRAMES * FRAME_POLLS / now, 1 - loss);
+}
+
+int main(void) {
+
+    static const double losses[] = {0, 0.01, 0.02, 0.05, 0.1, 0.2, 0.3, 0.4, 0.5};
+    unsigned int l;
+
+    printf("ARQ over a channel that loses frames and acks alike, %d frames of %d bytes per line\n\n",
+           FRAMES, FILL);
+    printf("%6s %12s %10s %10s %10s %10s\n", "loss", "frames sent", "data", "goodput", "speed", "no ARQ");
+    srand(7);
+    for (l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+        run(losses[l]);
+    }
+    printf("\ngoodput: new frames / frames sent, speed: against a channel without loss,\n"
+           "no ARQ: share of the frames that arrive without ARQ (the others are gone)\n");
+    return 0;
+}
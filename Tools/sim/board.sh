@@ -0,0 +1,41 @@
+#!/bin/sh
+# Builds one configuration of a board's main.c for the host. Every symbol the board
+# defines gets <prefix>_ in front, so several boards link into one simulation.
+#
+# usage: board.sh sender|receiver <prefix> <output.o> [NAME=VALUE]...
+#        NAME=VALUE replaces the value of "#define NAME" in main.c
+#        BOARD_CFLAGS adds compiler flags, BOARD_SED names a sed script run on main.c first
+set -e
+
+here=$(dirname "$0")
+board=$1
+prefix=$2
+out=$3
+shift 3
+
+case $board in
+sender)   src=$here/../../Source/LiFi_sender ;;
+receiver) src=$here/../../Source/LiFi_receiver ;;
+*)        echo "board.sh: the board is sender or receiver" >&2; exit 1 ;;
+esac
+
+c=${out%.o}.c
+# int is 16 bits on the MSP430, the sync word must keep its size on the host
+sed 's/^typedef unsigned int sync_word;/typedef uint16_t sync_word;/' "$src/main.c" > "$c"
+if [ -n "$BOARD_SED" ]; then
+    sed -i -f "$BOARD_SED" "$c"
+fi
+for setting in "$@"; do
+    name=${setting%%=*}
+    value=${setting#*=}
+    if ! grep -q "^#define $name " "$c"; then
+        echo "board.sh: no #define $name in the $board" >&2
+        exit 1
+    fi
+    sed -i "s|^#define $name\( \+\)[^ ]*|#define $name\1$value|" "$c"
+done
+
+# #pragma vector is for the TI compiler, the simulations call the ISRs by name
+${CC:-gcc} -std=gnu99 -Wall -Wextra -Wno-unknown-pragmas -c -fno-pic $BOARD_CFLAGS -I"$here/stub" -I"$here" -I"$src" -include host.h "$c" -o "$out"
+nm --defined-only "$out" | awk -v p="${prefix}_" 'NF == 3 { print $3, p $3 }' > "${out%.o}.syms"
+objcopy --redefine-syms="${out%.o}.syms" "$out"
@@ -0,0 +1,132 @@
+// Sampling point of the receiver against a sender whose clock is a few % off.
+//
+// Two builds of the receiver: CLOCK_RECOVERY 1 (phase and frequency loop) and 0 (TA0R
+// jumped to the middle of the symbol on every edge). Every cycle TA0 counts in up mode, its
+// tick samples the light like readSymbol() does, and the real Port_2 ISR runs EDGE_LATENCY
+// cycles after each rising edge (the NRZ frame only interrupts on those). The symbols of the
+// sender are SYMBOL_PERIOD * (1 + mismatch) receiver cycles long and every edge is moved by
+// up to JITTER cycles of noise.
+//
+// The frame is BITS long: RANDOM_RUN random bits, then ZERO_RUN 0s without any edge, over
+// and over. A line gives the number of bits sampled right before the first wrong one.
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <msp430.h>
+#include "sim.h"
+
+#define SYMBOL        480               // SYMBOL_PERIOD of the receiver, TIMER_COUNTER 480
+#define LATENCY       8                 // EDGE_LATENCY
+#define JITTER        24                // (cycles) largest shift of an edge, 5 % of a symbol
+#define BITS          4000
+#define RANDOM_RUN    300
+#define ZERO_RUN      200
+#define START         1000              // (cycles) first edge
+
+#define BOARD(p) \
+    extern int p##_main(void); \
+    extern void p##_Port_2(void); \
+    extern volatile unsigned int p##_receiving;
+BOARD(pll)
+BOARD(hard)
+
+struct rx {
+    const char *name;
+    int (*main)(void);
+    void (*edge)(void);
+    volatile unsigned int *receiving;
+};
+
+static const struct rx boards[] = {
+    {"loop", pll_main, pll_Port_2, &pll_receiving},
+    {"re-centring", hard_main, hard_Port_2, &hard_receiving},
+};
+
+static unsigned char bits[BITS];
+static double boundary[BITS + 1];      // Start of every bit on the receiver clock
+static jmp_buf init_done;
+
+static void idleInit(void) {
+
+    longjmp(init_done, 1);
+}
+
+static void frame(double mismatch) {
+
+    unsigned int k;
+
+    srand(5);
+    for (k = 0; k < BITS; k++) {
+        bits[k] = k % (RANDOM_RUN + ZERO_RUN) < RANDOM_RUN ? rand() & 1 : 0;
+        boundary[k] = START + k * SYMBOL * (1 + mismatch) + (k ? rand() % (2 * JITTER + 1) - JITTER : 0);
+    }
+    bits[0] = 1;                        // Start bit
+    boundary[BITS] = START + BITS * SYMBOL * (1 + mismatch);
+}
+
+// Bits sampled right before the first wrong one
+static unsigned int run(const struct rx *rx) {
+
+    unsigned long t, edge_at = 0;
+    unsigned int bit = 0, sampled = 0;
+    int level = 0;
+
+    sim_idle = idleInit;
+    if (!setjmp(init_done)) {
+        rx->main();
+    }
+    sim_idle = NULL;
+    TA0R = 0;
+
+    for (t = 0; sampled < BITS && bit < BITS; t++) {
+        while (bit < BITS && boundary[bit + 1] <= t) {
+            bit++;
+        }
+        if (t >= boundary[0] && bits[bit] != level) {
+            level = bits[bit];
+            if (level) {
+                edge_at = t + LATENCY;
+            }
+        }
+        if (edge_at == t && t != 0) {
+            rx->edge();
+        }
+
+        if (TA0R == TA0CCR0) {
+            TA0R = 0;
+            if (*rx->receiving) {       // readSymbol() wakes up on the tick
+                if (level != bits[sampled]) {
+                    return sampled;
+                }
+                sampled++;
+            }
+        }
+        else {
+            TA0R++;
+        }
+    }
+    return sampled;
+}
+
+int main(void) {
+
+    static const double mismatches[] = {-0.05, -0.04, -0.02, -0.01, 0, 0.01, 0.02, 0.04, 0.05};
+    unsigned int m, b, right;
+    int failed = 0;
+
+    printf("Bits sampled right out of %d (%d random, %d 0s, and again), edges moved by up to %d cycles\n\n",
+           BITS, RANDOM_RUN, ZERO_RUN, JITTER);
+    printf("%9s %12s %12s\n", "mismatch", boards[0].name, boards[1].name);
+    for (m = 0; m < sizeof(mismatches) / sizeof(mismatches[0]); m++) {
+        frame(mismatches[m]);
+        printf("%8.0f%%", 100 * mismatches[m]);
+        for (b = 0; b < sizeof(boards) / sizeof(boards[0]); b++) {
+            right = run(&boards[b]);
+            printf(" %12u", right);
+            failed |= b == 0 && right != BITS && mismatches[m] >= -0.04 && mismatches[m] <= 0.04;
+        }
+        printf("\n");
+    }
+    printf("\nThe loop must sample the whole frame right up to 4 %% off\n");
+    return failed;
+}
@@ -0,0 +1,149 @@
+// Bit errors of the convolutional code against noise on the light level.
+//
+// The sender encodes random frames of BUFFER_SIZE bytes and their crc with its
+// putCodedByte() and putParity() (tail included), for CONV_K 3, 5 and 7. Every coded bit
+// becomes an ADC12 reading, the light level (0 or 1) plus gaussian noise, and the receiver
+// maps it to a soft value the way readSoftBit() does with the tracked levels at 0 and 1.
+// Its viterbiDecode() gives the frame back.
+//
+// Eb/N0 is counted per payload bit: a coded bit gets half the energy of a bit sent without
+// coding. The "uncoded" column sends the same bits without the code, at the same Eb/N0,
+// "coded bits" is the share of coded bits on the wrong side of the threshold.
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <msp430.h>
+#include "sim.h"
+
+#define BYTES         34                // BUFFER_SIZE + sizeof(crc)
+#define SOFT_MAX      15
+#define FRAMES        2000
+
+#define BOARDS(k) \
+    extern int tx##k##_main(void); \
+    extern void tx##k##_putCodedByte(char byte); \
+    extern void tx##k##_putParity(void); \
+    extern unsigned int tx##k##_conv_state; \
+    extern char tx##k##_packet[]; \
+    extern unsigned int tx##k##_packet_length; \
+    extern int rx##k##_main(void); \
+    extern void rx##k##_viterbiDecode(unsigned int nBytes); \
+    extern unsigned char rx##k##_soft_samples[]; \
+    extern unsigned char rx##k##_conv_out[];
+BOARDS(3)
+BOARDS(5)
+BOARDS(7)
+
+struct code {
+    unsigned int k;
+    int (*tx_main)(void);
+    void (*putCodedByte)(char byte);
+    void (*putParity)(void);
+    unsigned int *conv_state;
+    char *packet;
+    unsigned int *packet_length;
+    int (*rx_main)(void);
+    void (*viterbiDecode)(unsigned int nBytes);
+    unsigned char *soft_samples;
+    unsigned char *conv_out;
+};
+
+#define CODE(k) {k, tx##k##_main, tx##k##_putCodedByte, tx##k##_putParity, &tx##k##_conv_state, tx##k##_packet, \
+                  &tx##k##_packet_length, rx##k##_main, rx##k##_viterbiDecode, rx##k##_soft_samples, rx##k##_conv_out}
+static const struct code codes[] = {CODE(3), CODE(5), CODE(7)};
+#define CODES (sizeof(codes) / sizeof(codes[0]))
+
+static jmp_buf init_done;
+
+static void idleInit(void) {
+
+    longjmp(init_done, 1);
+}
+
+static double gauss(void) {
+
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+// readSoftBit() with adc_zero at 0 and adc_one at 1
+static unsigned char soft(double level) {
+
+    double value = floor(level * SOFT_MAX);
+    return value <= 0 ? 0 : value > SOFT_MAX ? SOFT_MAX : value;
+}
+
+// Bit errors of FRAMES frames through one code, coded bits on the wrong side in *raw
+static double decode(const struct code *code, double sigma, double *raw) {
+
+    unsigned char bytes[BYTES];
+    unsigned long wrong = 0, raw_wrong = 0, coded = 0;
+    unsigned int frame, pos, bit;
+
+    for (frame = 0; frame < FRAMES; frame++) {
+        *code->packet_length = 0;
+        *code->conv_state = 0;
+        for (pos = 0; pos < BYTES; pos++) {
+            bytes[pos] = rand();
+            code->putCodedByte(bytes[pos]);
+        }
+        code->putParity();
+
+        for (pos = 0; pos < *code->packet_length; pos++) {
+            code->soft_samples[pos] = soft(code->packet[pos] + sigma * gauss());
+            raw_wrong += (code->soft_samples[pos] > SOFT_MAX / 2) != code->packet[pos];
+        }
+        coded += *code->packet_length;
+
+        code->viterbiDecode(BYTES);
+        for (pos = 0; pos < BYTES; pos++) {
+            for (bit = 0; bit < 8; bit++) {
+                wrong += ((code->conv_out[pos] ^ bytes[pos]) >> bit) & 1;
+            }
+        }
+    }
+    *raw = (double)raw_wrong / coded;
+    return (double)wrong / (FRAMES * BYTES * 8.0);
+}
+
+int main(void) {
+
+    unsigned int c, db;
+    unsigned long n, wrong;
+    double sigma, raw, ber[CODES];
+    int failed = 0;
+
+    for (c = 0; c < CODES; c++) {
+        sim_idle = idleInit;
+        if (!setjmp(init_done)) {
+            codes[c].tx_main();
+        }
+        if (!setjmp(init_done)) {
+            codes[c].rx_main();
+        }
+        sim_idle = NULL;
+    }
+
+    printf("Rate 1/2 convolutional code, %d frames of %d bytes per line, soft values 0 to %d\n\n",
+           FRAMES, BYTES, SOFT_MAX);
+    printf("%7s %10s %11s %10s %10s %10s\n", "Eb/N0", "uncoded", "coded bits", "CONV_K 3", "CONV_K 5", "CONV_K 7");
+    srand(11);
+    for (db = 0; db <= 6; db++) {
+        // Levels 0 and 1: an uncoded bit is wrong when the noise passes 1/2 = sqrt(2 Eb/N0) sigma
+        sigma = 0.5 / sqrt(2 * pow(10, db / 10.0));
+        wrong = 0;
+        for (n = 0; n < FRAMES * BYTES * 8ul; n++) {
+            wrong += sigma * gauss() > 0.5;
+        }
+        for (c = 0; c < CODES; c++) {
+            ber[c] = decode(&codes[c], sigma * sqrt(2), &raw);    // Half the energy per coded bit
+        }
+        printf("%5u dB %10.1e %11.1e %10.1e %10.1e %10.1e\n", db, (double)wrong / n, raw, ber[0], ber[1], ber[2]);
+        for (c = 0; c < CODES; c++) {
+            failed |= db >= 4 && ber[c] >= (double)wrong / n;
+        }
+    }
+    printf("\nFrom 4 dB every CONV_K must leave fewer wrong bits than no code\n");
+    return failed;
+}
@@ -0,0 +1,144 @@
+// Frames the fountain code needs to bring a block across a channel that loses frames.
+//
+// The sender and the receiver are built with FOUNTAIN, FOUNTAIN_K 16. The real
+// sendFountain() of the sender builds every frame; its sendPacket() is cut short when it
+// waits for the frame to go out, the frame goes through a channel that loses it with a given
+// probability, and the real fountainReceive() of the receiver takes it. The line code and
+// the crc play no part: a frame either comes whole or not at all.
+//
+// The next block is filled once the receiver has decoded one, so the sender moves on after
+// FOUNTAIN_SYMBOLS frames. On a "join" line the receiver misses the first 1 to JOIN frames of
+// every block, as if it started listening in the middle of it. Every line checks that the
+// computer got all the blocks in order.
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <msp430.h>
+#include "sim.h"
+
+#define K             16                // FOUNTAIN_K
+#define FILL          28                // BUFFER_FILL of the sender: FOUNTAIN_SYMBOL_SIZE - HEADER_SIZE
+#define FRAME_BYTES   33                // HEADER_SIZE + BUFFER_SIZE
+#define BLOCKS        1000
+#define JOIN          32                // Most frames of a block the late receiver misses (FOUNTAIN_SYMBOLS)
+#define GIVE_UP       1000              // Frames of one block without decoding it
+
+extern int tx_main(void);
+extern char tx_storeByte(char byte);
+extern void tx_sendFountain(void);
+extern char tx_fountain_frame[];
+extern unsigned char tx_fountain_block;
+extern volatile unsigned int tx_sending;
+
+extern int rx_main(void);
+extern void rx_fountainReceive(void);
+extern char rx_buffer[];
+extern unsigned int rx_frame_length;
+extern unsigned int rx_fountain_decoded;
+extern unsigned char rx_fountain_block;
+
+static jmp_buf init_done;
+static char on_air[FRAME_BYTES];
+
+static void idleInit(void) {
+
+    longjmp(init_done, 1);
+}
+
+// sendPacket() waits for the stop bit: the frame is on the air
+static void airFrame(void) {
+
+    memcpy(on_air, tx_fountain_frame, FRAME_BYTES);
+    tx_sending = 0;
+}
+
+static unsigned char sentByte(unsigned long n) {
+
+    return n * 7 + n / FILL;
+}
+
+static int compareCounts(const void *a, const void *b) {
+
+    return *(const unsigned int *)a - *(const unsigned int *)b;
+}
+
+static int run(double loss, unsigned int join) {
+
+    static unsigned int good[BLOCKS];
+    unsigned long fed = 0, sent = 0, bad = 0, n;
+    unsigned int block, frames, pos, missed;
+    unsigned char number = tx_fountain_block;      // The sender keeps counting from the last line
+    double total = 0;
+
+    sim_idle = idleInit;
+    if (!setjmp(init_done)) {
+        tx_main();
+    }
+    if (!setjmp(init_done)) {
+        rx_main();
+    }
+    sim_idle = airFrame;
+    stub_sr = GIE;
+    uart_n = 0;
+
+    for (block = 0; block < BLOCKS; block++) {
+        for (pos = 0; pos < K * FILL; pos++) {
+            tx_storeByte(sentByte(fed++));
+        }
+        number++;
+        good[block] = 0;
+        missed = join ? rand() % join + 1 : 0;
+
+        // The last block stays on the air until the sender has sent FOUNTAIN_SYMBOLS of it
+        for (frames = 0; frames < GIVE_UP; ) {
+            tx_sendFountain();
+            sent++;
+            if ((unsigned char)on_air[1] != number) {
+                continue;
+            }
+            frames++;
+            if (frames <= missed || (double)rand() / RAND_MAX < loss) {
+                continue;
+            }
+            memcpy(rx_buffer, on_air, FRAME_BYTES);
+            rx_frame_length = (unsigned char)on_air[0];
+            rx_fountainReceive();
+            good[block]++;
+            if (rx_fountain_block == number && rx_fountain_decoded == (1u << K) - 1) {
+                break;
+            }
+        }
+        total += frames;
+    }
+    sim_idle = NULL;
+
+    for (n = 0; n < uart_n && n < fed; n++) {
+        bad += uart_sink[n] != sentByte(n);
+    }
+    qsort(good, BLOCKS, sizeof(good[0]), compareCounts);
+    printf("%5.0f%% %5u %10s %8.2f %8u %8u %10.1f\n", 100 * loss, join,
+           uart_n < fed ? "LOST" : bad ? "CORRUPT" : "in order", good[BLOCKS / 2 - 1] / (double)K,
+           good[BLOCKS * 95 / 100 - 1], good[BLOCKS - 1], total / BLOCKS);
+    return uart_n < fed || bad;
+}
+
+int main(void) {
+
+    static const double losses[] = {0, 0.1, 0.2, 0.3, 0.4, 0.5};
+    unsigned int l;
+    int failed = 0;
+
+    printf("Fountain code, FOUNTAIN_K %d buffers of %d bytes, %d blocks per line\n\n", K, FILL, BLOCKS);
+    printf("%6s %5s %10s %8s %8s %8s %10s\n", "loss", "join", "data", "median", "95 %", "most", "on the air");
+    srand(13);
+    for (l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+        failed |= run(losses[l], 0);
+    }
+    for (l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+        failed |= run(losses[l], JOIN);
+    }
+    printf("\nmedian: good frames needed to decode a block, in blocks of FOUNTAIN_K frames,\n"
+           "95 %%, most: in frames, on the air: frames of the block sent until it was decoded\n");
+    return failed;
+}
@@ -0,0 +1,115 @@
+// Bits of the PAM light levels, from the putGroup() of the sender to the readGroup() of the receiver.
+//
+// Both boards are built with LINE_4PAM and with LINE_8PAM. Every group of bits goes through
+// the sender, the receiver gets the ADC12 reading of the level the sender chose, and of the
+// levels next to it: the level itself must give back the same bits, a level one step too
+// high or too low exactly one wrong bit.
+#include <stdio.h>
+#include <msp430.h>
+#include "sim.h"
+
+#define BOARDS(n) \
+    extern unsigned int tx##n##_group, tx##n##_group_fill; \
+    extern char tx##n##_packet[]; \
+    extern unsigned int tx##n##_packet_length; \
+    extern void tx##n##_putGroup(void); \
+    extern unsigned int rx##n##_group, rx##n##_group_fill; \
+    extern unsigned int rx##n##_pam_threshold[]; \
+    extern void rx##n##_readGroup(void);
+BOARDS(4)
+BOARDS(8)
+
+struct pam {
+    unsigned int levels;
+    unsigned int *tx_group, *tx_group_fill;
+    char *packet;
+    unsigned int *packet_length;
+    void (*putGroup)(void);
+    unsigned int *rx_group, *rx_group_fill;
+    unsigned int *pam_threshold;
+    void (*readGroup)(void);
+};
+
+#define PAM(n) {n, &tx##n##_group, &tx##n##_group_fill, tx##n##_packet, &tx##n##_packet_length, tx##n##_putGroup, \
+                 &rx##n##_group, &rx##n##_group_fill, rx##n##_pam_threshold, rx##n##_readGroup}
+static const struct pam pams[] = {PAM(4), PAM(8)};
+
+#define STEP 200                        // ADC12 reading between two levels
+
+// TB0CCR2 duty the sender uses for the bits
+static unsigned char duty(const struct pam *pam, unsigned int bits) {
+
+    *pam->tx_group = bits;
+    *pam->tx_group_fill = 0;
+    *pam->packet_length = 0;
+    pam->putGroup();
+    return (unsigned char)pam->packet[0];
+}
+
+// Bits the receiver reads from a light level
+static unsigned int bitsOf(const struct pam *pam, unsigned int level) {
+
+    ADC12MEM0 = level * STEP;
+    pam->readGroup();
+    return *pam->rx_group;
+}
+
+static unsigned int ones(unsigned int x) {
+
+    unsigned int n = 0;
+
+    for (; x; x >>= 1) {
+        n += x & 1;
+    }
+    return n;
+}
+
+static int check(const struct pam *pam) {
+
+    unsigned int bits, level, other, side, wrong = 0, n;
+    unsigned int level_of[8];
+
+    for (level = 0; level < pam->levels - 1; level++) {
+        pam->pam_threshold[level] = level * STEP + STEP / 2;
+    }
+
+    // The duties go up with the level: the level of some bits is the number of duties below theirs
+    for (bits = 0; bits < pam->levels; bits++) {
+        level_of[bits] = 0;
+        for (other = 0; other < pam->levels; other++) {
+            level_of[bits] += duty(pam, other) < duty(pam, bits);
+        }
+    }
+
+    printf("%uPAM  bits -> level -> bits, bits at level - 1 / + 1 (wrong bits)\n", pam->levels);
+    for (bits = 0; bits < pam->levels; bits++) {
+        level = level_of[bits];
+        printf("      %u -> %u -> %u", bits, level, bitsOf(pam, level));
+        wrong += bitsOf(pam, level) != bits;
+        for (side = 0; side < 2; side++) {
+            other = side ? level + 1 : level - 1;
+            if (other >= pam->levels) {     // Also level 0 - 1
+                printf("       ");
+                continue;
+            }
+            n = ones(bitsOf(pam, other) ^ bits);
+            printf("   %u (%u)", bitsOf(pam, other), n);
+            wrong += n != 1;
+        }
+        printf("\n");
+    }
+    printf("      %s\n\n", wrong ? "WRONG: a level gives other bits or a neighbour more than one wrong bit"
+                                 : "ok, every neighbouring level is one wrong bit");
+    return wrong != 0;
+}
+
+int main(void) {
+
+    unsigned int p;
+    int failed = 0;
+
+    for (p = 0; p < sizeof(pams) / sizeof(pams[0]); p++) {
+        failed |= check(&pams[p]);
+    }
+    return failed;
+}
@@ -0,0 +1,249 @@
+// Rate the sender settles on when the faster rates lose more frames.
+//
+// Both boards are built with ARQ and RATE_ADAPT, RATE_STEPS 3 at TIMER_COUNTER 1920 (the
+// receiver refuses four rates at 480): symbols of 1920, 960, 480 and 240 cycles. The real
+// arqUpdate(), rateUpdate(), arqSelect() and sendPacket() of the sender run, sendPacket() is
+// cut short when it waits for the stop bit. The frame is on the air for its packet_length
+// symbols of the sender's rate, while the TA2 poll of the sender and the TA0 tick of the
+// receiver (rate_silence, link_wait) go on, then endReception() of the receiver runs. The
+// channel loses a frame with the probability of its rate, and always when the receiver is
+// on another rate; the frames that get through go to arqReceive() or linkReceive(). Acks
+// come back whole ACK_POLLS later. A frame is about 25 polls at TIMER_COUNTER 1920, so the
+// sender gets ARQ_TIMEOUT 60 or every frame would time out.
+//
+// A line gives the share of the time the sender spent at each rate, and the frames sent
+// while the receiver was on another one. Every line checks that the computer got all the
+// data in order, and without loss no frame may go out at the wrong rate.
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <msp430.h>
+#include "sim.h"
+
+#define TIMER_COUNTER 1920
+#define RATES         4                 // RATE_STEPS + 1
+#define ACK_POLLS     6                 // Ack on the wire
+#define FRAMES        20000
+#define FILL          31                // BUFFER_FILL of the sender: BUFFER_SIZE - ARQ_HEADER
+#define FRAME_BYTES   33                // HEADER_SIZE + BUFFER_SIZE
+#define ACK_BYTES     5                 // ARQ_ACK_SIZE
+#define MAX_ACKS      64
+
+extern int tx_main(void);
+extern char tx_storeByte(char byte);
+extern void tx_arqUpdate(void);
+extern void tx_rateUpdate(void);
+extern char tx_arqSelect(void);
+extern void tx_sendPacket(void);
+extern void tx_USCI_A0_ISR(void);
+extern void tx_TIMER2_A0_ISR(void);
+extern char tx_buffer[][FRAME_BYTES];
+extern char tx_link_frame[];
+extern char tx_link_sending;
+extern unsigned char tx_link_rate;
+extern unsigned int tx_packet_length;
+extern volatile unsigned int tx_send_index, tx_frames_ready, tx_sending;
+
+extern int rx_main(void);
+extern void rx_arqReceive(void);
+extern void rx_linkReceive(void);
+extern void rx_TIMER0_A0_ISR(void);
+extern void rx_endReception(void);
+extern char rx_buffer[];
+extern unsigned int rx_frame_length;
+extern unsigned char rx_arq_ack_next[];
+extern volatile char rx_arq_ack_due;
+extern unsigned char rx_link_rate;
+extern volatile unsigned long rx_rate_silence;
+extern volatile unsigned int rx_receiving;
+
+struct channel {
+    const char *name;
+    double loss[RATES];                 // Frames lost at each rate
+};
+
+static const struct channel channels[] = {
+    {"clean", {0, 0, 0, 0}},
+    {"top rate dead", {0, 0, 0, 1}},
+    {"mild", {0, 0.005, 0.03, 0.5}},
+    {"harsh", {0, 0.02, 0.4, 0.9}},
+};
+
+static jmp_buf init_done;
+static const struct channel *channel;
+
+// Cycles since the start of the line, next TA2 poll of the sender and TA0 tick of the receiver
+static double now, next_poll, next_tick;
+static double rate_time[RATES];
+static unsigned long wrong_rate;
+
+// Acks on the way back, with the cycle they arrive at
+static unsigned char acks[MAX_ACKS][ACK_BYTES];
+static double ack_time[MAX_ACKS];
+static unsigned int ack_count;
+
+static void idleInit(void) {
+
+    longjmp(init_done, 1);              // main() is set up and waits
+}
+
+static unsigned char sentByte(unsigned long n) {
+
+    return n * 7 + n / FILL;
+}
+
+// Runs the TA2 polls and TA0 ticks up to cycle until
+static void advance(double until) {
+
+    double next;
+
+    while ((next = next_poll < next_tick ? next_poll : next_tick) <= until) {
+        rate_time[tx_link_rate] += next - now;
+        now = next;
+        if (next_poll <= next_tick) {
+            tx_TIMER2_A0_ISR();
+            next_poll += SIM_POLL_CYCLES;
+        }
+        else {
+            rx_TIMER0_A0_ISR();
+            next_tick += TIMER_COUNTER >> rx_link_rate;
+        }
+    }
+    rate_time[tx_link_rate] += until - now;
+    now = until;
+}
+
+// Ack bytes that arrived by now go through the UCA0 RX interrupt of the sender
+static void deliverAcks(void) {
+
+    unsigned int k = 0, b;
+
+    while (k < ack_count) {
+        if (ack_time[k] > now) {
+            k++;
+            continue;
+        }
+        for (b = 0; b < ACK_BYTES; b++) {
+            UCA0IV = 2;
+            UCA0RXBUF = acks[k][b];
+            tx_USCI_A0_ISR();
+        }
+        ack_count--;
+        memmove(acks[k], acks[k + 1], (ack_count - k) * ACK_BYTES);
+        memmove(&ack_time[k], &ack_time[k + 1], (ack_count - k) * sizeof(ack_time[0]));
+    }
+}
+
+// sendPacket() waits for the stop bit: the frame is on the air
+static void airFrame(void) {
+
+    char *frame = tx_link_sending ? tx_link_frame : tx_buffer[tx_send_index];
+    unsigned char rate = tx_link_rate;
+    int heard = rx_link_rate == rate;
+
+    wrong_rate += !heard;
+    heard &= (double)rand() / RAND_MAX >= channel->loss[rate];
+    rx_receiving = 1;
+    advance(now + (double)tx_packet_length * (TIMER_COUNTER >> rate));
+    rx_endReception();
+    tx_sending = 0;
+    if (!heard) {
+        return;
+    }
+
+    memcpy(rx_buffer, frame, 1 + (unsigned char)frame[0]);
+    rx_frame_length = (unsigned char)frame[0];
+    if (tx_link_sending) {
+        rx_linkReceive();
+        return;
+    }
+    rx_rate_silence = 0;
+    rx_arqReceive();
+    if (rx_arq_ack_due) {
+        rx_arq_ack_due = 0;
+        if (ack_count < MAX_ACKS) {
+            memcpy(acks[ack_count], rx_arq_ack_next, ACK_BYTES);
+            ack_time[ack_count++] = now + ACK_POLLS * SIM_POLL_CYCLES;
+        }
+    }
+}
+
+static int run(const struct channel *line) {
+
+    unsigned long total = (unsigned long)FRAMES * FILL, fed = 0, bad = 0, n;
+    unsigned int r;
+    int clean = 1;
+
+    sim_idle = idleInit;
+    if (!setjmp(init_done)) {
+        tx_main();
+    }
+    if (!setjmp(init_done)) {
+        rx_main();
+    }
+    sim_idle = airFrame;
+    stub_sr = GIE;
+    uart_n = 0;
+    ack_count = 0;
+    channel = line;
+    now = 0;
+    next_poll = SIM_POLL_CYCLES;
+    next_tick = TIMER_COUNTER;
+    wrong_rate = 0;
+    memset(rate_time, 0, sizeof(rate_time));
+
+    while (uart_n < total && now < 600.0 * SIM_CLOCK) {
+        while (fed < total && tx_frames_ready < 8) {
+            tx_storeByte(sentByte(fed++));
+        }
+        deliverAcks();
+
+        tx_arqUpdate();
+        tx_rateUpdate();                // Sends its link frames through airFrame()
+        if (tx_arqSelect()) {
+            tx_sendPacket();
+        }
+        else {
+            advance(next_poll);         // Waits for acks or for ARQ_TIMEOUT
+        }
+    }
+    sim_idle = NULL;
+
+    for (n = 0; n < uart_n && n < total; n++) {
+        bad += uart_sink[n] != sentByte(n);
+    }
+    printf("%-14s", line->name);
+    for (r = 0; r < RATES; r++) {
+        printf(" %6.1f%%", 100 * rate_time[r] / now);
+        clean &= line->loss[r] == 0;
+    }
+    printf(" %10lu %10.1f %10s\n", wrong_rate, total * 8 / (now / SIM_CLOCK) / 1000,
+           uart_n < total ? "STALLED" : bad ? "CORRUPT" : "in order");
+    return uart_n < total || bad || (clean && wrong_rate != 0);
+}
+
+int main(void) {
+
+    unsigned int c, r;
+    int failed = 0;
+
+    printf("Rate adaptation, %d frames of %d bytes per line, frames lost per rate:\n\n", FRAMES, FILL);
+    for (c = 0; c < sizeof(channels) / sizeof(channels[0]); c++) {
+        printf("%-14s", channels[c].name);
+        for (r = 0; r < RATES; r++) {
+            printf(" %6.1f%%", 100 * channels[c].loss[r]);
+        }
+        printf("\n");
+    }
+    printf("\n%-14s %7s %7s %7s %7s %10s %10s %10s\n", "channel", "/ 1", "/ 2", "/ 4", "/ 8",
+           "wrong rate", "kbit/s", "data");
+    srand(17);
+    for (c = 0; c < sizeof(channels) / sizeof(channels[0]); c++) {
+        failed |= run(&channels[c]);
+    }
+    printf("\n/ 1 ... / 8: share of the time at TIMER_COUNTER / 1 ... / 8, wrong rate: frames sent\n"
+           "while the receiver was on another rate, kbit/s: data that reached the computer\n");
+    printf("Without loss no frame may go out while the receiver is on another rate\n");
+    return failed;
+}
@@ -0,0 +1,196 @@
+// Cost of the Reed-Solomon code of the boards, for several RS_PARITY and frame lengths.
+//
+// The sender encodes random frames with its rsEncode(), wrong bytes are put in the codeword
+// and the receiver runs its rsFeed() and rsDecode() on it. Both boards are built with
+// -finstrument-functions, every call of gfMul() and gfDiv() is counted, and rs_steps.sed
+// counts the products the receiver takes straight from gf_exp[] without a call. Nearly all
+// the time goes to these GF(256) operations, so the cycles are the calls times C_GF_OP and
+// the steps times C_GF_STEP, estimates for the MSP430X (zero test, table lookups and the
+// loop step around them, plus the call and return for C_GF_OP). The sender sizes its gap
+// with the same two figures (RS_GF_CYCLES, RS_STEP_CYCLES).
+//
+// Two limits are checked on the receiver:
+// - rsFeed() runs between the last symbol of a byte and the first of the next one, it must
+//   be done within one symbol or the TA0 tick that should wake readSymbol() is lost.
+// - rsDecode() runs after the stop bit, it must be done before the start bit of the next
+//   frame. The sender leaves its own encoding time, one symbol and the idle symbols of
+//   putDecodeGap() between frames.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define C_GF_OP       40                // (cycles) gfMul()/gfDiv() with the loop step around it
+#define C_GF_STEP     22                // (cycles) a product taken from gf_exp[] in the loop, zero test included
+#define C_READ        60                // (cycles) readByte() return, readCodedByte(), next readSymbol() call
+#define TIMER_COUNTER 480               // Symbol of both boards (NRZ)
+#define HEADER_SIZE   1
+#define CRC_SIZE      2
+#define TRIALS        2000
+
+#define BOARDS(p) \
+    extern void tx##p##_rsInit(void); \
+    extern void tx##p##_rsEncode(unsigned char byte); \
+    extern unsigned char tx##p##_rs_parity[]; \
+    extern unsigned char tx##p##_gfMul(unsigned char a, unsigned char b); \
+    extern void tx##p##_putDecodeGap(unsigned int length); \
+    extern unsigned int tx##p##_packet_length; \
+    extern void rx##p##_rsStart(void); \
+    extern void rx##p##_rsFeed(unsigned char byte); \
+    extern char rx##p##_rsDecode(void); \
+    extern unsigned char rx##p##_rs_block[]; \
+    extern unsigned char rx##p##_gfMul(unsigned char a, unsigned char b); \
+    extern unsigned char rx##p##_gfDiv(unsigned char a, unsigned char b);
+BOARDS(2)
+BOARDS(4)
+BOARDS(8)
+BOARDS(16)
+
+struct code {
+    unsigned int parity;
+    void (*rsInit)(void);
+    void (*rsEncode)(unsigned char byte);
+    unsigned char *rs_parity;
+    void (*putDecodeGap)(unsigned int length);
+    unsigned int *packet_length;
+    void (*rsStart)(void);
+    void (*rsFeed)(unsigned char byte);
+    char (*rsDecode)(void);
+    unsigned char *rs_block;
+    void *gf[3];                        // Functions that count as a GF operation
+};
+
+#define CODE(p) {p, tx##p##_rsInit, tx##p##_rsEncode, tx##p##_rs_parity, tx##p##_putDecodeGap, &tx##p##_packet_length, \
+                  rx##p##_rsStart, rx##p##_rsFeed, \
+                  rx##p##_rsDecode, rx##p##_rs_block, {tx##p##_gfMul, rx##p##_gfMul, rx##p##_gfDiv}}
+static const struct code codes[] = {CODE(2), CODE(4), CODE(8), CODE(16)};
+
+static const struct code *counted;
+static unsigned long gf_ops;
+unsigned long sim_gf_steps;
+
+// Cycles of the GF(256) work counted since the last reset
+static unsigned long gfCycles(void) {
+
+    return gf_ops * C_GF_OP + sim_gf_steps * C_GF_STEP;
+}
+
+static void gfReset(void) {
+
+    gf_ops = 0;
+    sim_gf_steps = 0;
+}
+
+__attribute__((no_instrument_function))
+void __cyg_profile_func_enter(void *function, void *call_site) {
+
+    if (counted && (function == counted->gf[0] || function == counted->gf[1] || function == counted->gf[2])) {
+        gf_ops++;
+    }
+}
+
+__attribute__((no_instrument_function))
+void __cyg_profile_func_exit(void *function, void *call_site) {
+}
+
+// Codeword of a random frame with `payload` bytes, returns its length
+static unsigned int encode(const struct code *code, unsigned int payload, unsigned char *codeword) {
+
+    unsigned int k = HEADER_SIZE + payload + CRC_SIZE;
+    unsigned int pos;
+
+    memset(code->rs_parity, 0, code->parity);
+    codeword[0] = payload;
+    for (pos = 1; pos < k; pos++) {
+        codeword[pos] = rand();
+    }
+    for (pos = 0; pos < k; pos++) {
+        code->rsEncode(codeword[pos]);
+    }
+    memcpy(codeword + k, code->rs_parity, code->parity);
+    return k + code->parity;
+}
+
+static void bench(const struct code *code, unsigned int payload) {
+
+    unsigned char codeword[256], received[256];
+    unsigned int n, errors, trial, pos, e;
+    unsigned long gap, feed, cycles, max_cycles;
+    double total_cycles;
+    unsigned int fixed, caught;
+
+    counted = code;
+    gfReset();
+    n = encode(code, payload, codeword);
+    gap = gfCycles() + TIMER_COUNTER;
+    *code->packet_length = 0;
+    code->putDecodeGap(HEADER_SIZE + payload);
+    gap += (unsigned long)*code->packet_length * TIMER_COUNTER;
+
+    // Syndromes of one byte, none of them 0
+    code->rsStart();
+    code->rsFeed(1);
+    gfReset();
+    code->rsFeed(0);
+    feed = gfCycles();
+
+    printf("RS(%u,%u) parity %2u, rsFeed %4lu cycles a byte (%s one symbol), gap %6lu cycles (%u idle symbols)\n",
+           n, n - code->parity, code->parity, feed, feed + C_READ <= TIMER_COUNTER ? "within" : "LONGER than",
+           gap, *code->packet_length);
+
+    for (errors = 0; errors <= code->parity / 2 + 1; errors++) {
+        total_cycles = 0;
+        max_cycles = 0;
+        fixed = 0;
+        caught = 0;
+        for (trial = 0; trial < TRIALS; trial++) {
+            encode(code, payload, codeword);
+            memcpy(received, codeword, n);
+            for (e = 0; e < errors;) {
+                pos = rand() % n;
+                if (received[pos] == codeword[pos]) {
+                    received[pos] ^= 1 + rand() % 255;
+                    e++;
+                }
+            }
+
+            code->rsStart();
+            for (pos = 0; pos < n; pos++) {
+                code->rsFeed(received[pos]);
+            }
+            gfReset();
+            if (code->rsDecode()) {
+                fixed += memcmp(code->rs_block, codeword, n) == 0;
+            }
+            else {
+                caught++;
+            }
+            cycles = gfCycles();
+            total_cycles += cycles;
+            if (cycles > max_cycles) {
+                max_cycles = cycles;
+            }
+        }
+        printf("  %2u wrong bytes: rsDecode %6.0f cycles on average, %6lu at most (%4.0f%% of the gap), "
+               "%5.1f%% fixed, %5.1f%% refused\n", errors, total_cycles / TRIALS, max_cycles,
+               100.0 * max_cycles / gap, 100.0 * fixed / TRIALS, 100.0 * caught / TRIALS);
+    }
+    counted = NULL;
+}
+
+int main(void) {
+
+    static const unsigned int payloads[] = {8, 32};
+    unsigned int c, p;
+
+    printf("Reed-Solomon cost on the receiver, %d frames per line, %d cycles per gfMul()/gfDiv(), "
+           "%d per gf_exp[] step, TIMER_COUNTER %d\n\n", TRIALS, C_GF_OP, C_GF_STEP, TIMER_COUNTER);
+    srand(1);
+    for (c = 0; c < sizeof(codes) / sizeof(codes[0]); c++) {
+        codes[c].rsInit();
+        for (p = 0; p < sizeof(payloads) / sizeof(payloads[0]); p++) {
+            bench(&codes[c], payloads[p]);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+// Shared by the simulations and the stubs
+#ifndef SIM_H
+#define SIM_H
+#include <stdint.h>
+
+#define SIM_CLOCK       24000000        // (hertz) SMCLK and MCLK of both boards
+#define SIM_POLL_CYCLES (SIM_CLOCK / 32768.0 * 32)     // TA2 UART poll period of the sender (UART_POLL_COUNTER ACLK cycles)
+
+extern unsigned stub_sr;
+extern void (*sim_idle)(void);
+extern unsigned int sim_timer_counter;
+extern unsigned char uart_sink[];
+extern unsigned int uart_n;
+
+// DMA channel as set up through driverlib
+struct sim_dma {
+    uint32_t src, dst, src_start, dst_start;
+    uint16_t size, left, mode;
+    uint8_t trigger, unit, src_step, dst_step;
+    uint8_t enabled, interrupt, flag;
+    unsigned long transfers;
+};
+extern struct sim_dma sim_dma[3];
+int sim_dmaTransfer(int number);
+
+#endif
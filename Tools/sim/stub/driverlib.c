@@ -0,0 +1,182 @@
+// The driverlib calls of the two boards. DMA channels keep their settings so that the
+// simulation can run their transfers, the CRC module computes a real CRC-16-CCITT.
+#include <stdbool.h>
+#include <msp430.h>
+#include "MSP430F5xx_6xx/driverlib.h"
+#include "sim.h"
+
+struct sim_dma sim_dma[3];
+static uint16_t crc_result;
+
+static struct sim_dma *channel(uint8_t channelSelect) {
+
+    return &sim_dma[channelSelect >> 4];        // DMA_CHANNEL_x is the register offset, 0x10 apart
+}
+
+// CRCDI takes every byte from bit 0, like the CRC module of the F5529
+static void crcFeed(uint8_t byte) {
+
+    unsigned int bit;
+    for (bit = 0; bit < 8; bit++) {
+        uint16_t feedback = ((crc_result >> 15) ^ (byte >> bit)) & 1;
+        crc_result <<= 1;
+        if (feedback) {
+            crc_result ^= 0x1021;
+        }
+    }
+}
+
+// One transfer of a channel, returns 1 when it was the last one of the block
+int sim_dmaTransfer(int number) {
+
+    struct sim_dma *dma = &sim_dma[number];
+    uint16_t value;
+
+    if (!dma->enabled) {
+        return 0;
+    }
+    value = *(volatile uint8_t *)(uintptr_t)dma->src;
+    if (!(dma->unit & DMASRCBYTE)) {
+        value = *(volatile uint16_t *)(uintptr_t)dma->src;
+    }
+    if (dma->dst == CRC_BASE + OFS_CRCDI_L) {
+        crcFeed(value);
+    }
+    else if (dma->unit & DMADSTBYTE) {
+        *(volatile uint8_t *)(uintptr_t)dma->dst = value;
+    }
+    else {
+        *(volatile uint16_t *)(uintptr_t)dma->dst = value;
+    }
+    dma->transfers++;
+
+    if (dma->src_step) {
+        dma->src += (dma->unit & DMASRCBYTE) ? 1 : 2;
+    }
+    if (dma->dst_step) {
+        dma->dst += (dma->unit & DMADSTBYTE) ? 1 : 2;
+    }
+    if (--dma->left != 0) {
+        return 0;
+    }
+    // Block done: the addresses and the size are reloaded, single transfer mode stops
+    dma->src = dma->src_start;
+    dma->dst = dma->dst_start;
+    dma->left = dma->size;
+    dma->flag = 1;
+    if (dma->mode != DMA_TRANSFER_REPEATED_SINGLE) {
+        dma->enabled = 0;
+    }
+    return 1;
+}
+
+void DMA_init(DMA_initParam *param) {
+
+    struct sim_dma *dma = channel(param->channelSelect);
+    dma->mode = param->transferModeSelect;
+    dma->size = param->transferSize;
+    dma->left = param->transferSize;
+    dma->trigger = param->triggerSourceSelect;
+    dma->unit = param->transferUnitSelect;
+    dma->enabled = 0;
+    dma->flag = 0;
+}
+
+void DMA_setTransferSize(uint8_t channelSelect, uint16_t transferSize) {
+
+    channel(channelSelect)->size = transferSize;
+    channel(channelSelect)->left = transferSize;
+}
+
+uint16_t DMA_getTransferSize(uint8_t channelSelect) {
+
+    return channel(channelSelect)->left;
+}
+
+void DMA_setSrcAddress(uint8_t channelSelect, uint32_t srcAddress, uint16_t directionSelect) {
+
+    channel(channelSelect)->src = srcAddress;
+    channel(channelSelect)->src_start = srcAddress;
+    channel(channelSelect)->src_step = (directionSelect == DMA_DIRECTION_INCREMENT);
+}
+
+void DMA_setDstAddress(uint8_t channelSelect, uint32_t dstAddress, uint16_t directionSelect) {
+
+    channel(channelSelect)->dst = dstAddress;
+    channel(channelSelect)->dst_start = dstAddress;
+    channel(channelSelect)->dst_step = (directionSelect == DMA_DIRECTION_INCREMENT);
+}
+
+void DMA_enableTransfers(uint8_t channelSelect) {
+
+    channel(channelSelect)->enabled = 1;
+}
+
+void DMA_disableTransfers(uint8_t channelSelect) {
+
+    channel(channelSelect)->enabled = 0;
+}
+
+// DMAREQ: a block transfer runs to the end at once, the CPU is held meanwhile
+void DMA_startTransfer(uint8_t channelSelect) {
+
+    int number = channelSelect >> 4;
+    if (sim_dma[number].mode == DMA_TRANSFER_BLOCK) {
+        while (!sim_dmaTransfer(number) && sim_dma[number].enabled);
+    }
+    else {
+        sim_dmaTransfer(number);
+    }
+}
+
+void DMA_enableInterrupt(uint8_t channelSelect) {
+
+    channel(channelSelect)->interrupt = 1;
+}
+
+uint16_t DMA_getInterruptStatus(uint8_t channelSelect) {
+
+    return channel(channelSelect)->flag ? DMA_INT_ACTIVE : DMA_INT_INACTIVE;
+}
+
+void DMA_clearInterrupt(uint8_t channelSelect) {
+
+    channel(channelSelect)->flag = 0;
+}
+
+void CRC_setSeed(uint16_t baseAddress, uint16_t seed) {
+
+    crc_result = seed;
+}
+
+uint16_t CRC_getResult(uint16_t baseAddress) {
+
+    return crc_result;
+}
+
+bool PMM_setVCore(uint8_t level) {
+
+    return true;
+}
+
+void UCS_initClockSignal(uint8_t selectedClockSignal, uint16_t clockSource, uint16_t clockSourceDivider) {
+}
+
+void UCS_initFLLSettle(uint16_t fsystem, uint16_t ratio) {
+}
+
+uint32_t UCS_getSMCLK(void) {
+
+    return 24000000;
+}
+
+uint32_t USCI_A_UART_getReceiveBufferAddressForDMA(uint16_t baseAddress) {
+
+    return (uint32_t)(uintptr_t)&UCA1RXBUF;
+}
+
+void Timer_B_outputPWM(uint16_t baseAddress, Timer_B_outputPWMParam *param) {
+
+    TB0CCR0 = param->timerPeriod;
+    TB0CCR2 = param->dutyCycle;
+}
@@ -0,0 +1,15 @@
+// Included in front of a board's main.c by board.sh
+#include <msp430.h>
+
+// Bytes for the computer end up in uart_sink[], in the order they were written
+extern unsigned char uart_sink[];
+extern unsigned int uart_n;
+#undef UCA1TXBUF
+#define UCA1TXBUF uart_sink[uart_n++]
+
+// A config value can be one of these instead of a constant, so one build covers a sweep
+extern unsigned int sim_timer_counter;
+
+// rs_bench: GF(256) steps through gf_exp[] that don't go through gfMul(), see rs_steps.sed
+extern unsigned long sim_gf_steps;
+#define SIM_GF_STEP(table) (sim_gf_steps++, table)
@@ -0,0 +1,203 @@
+// Host stand-in for the MSP430F5529 device header. The registers are plain variables
+// (stub/regs.c), the intrinsics go through the hooks of the simulation.
+#ifndef STUB_MSP430_H
+#define STUB_MSP430_H
+#include <stdint.h>
+#define __MSP430_HAS_ADC12_PLUS__
+#define __MSP430_HAS_CRC__
+#define __MSP430_HAS_PORT1_R__
+#define __MSP430_HAS_PORT_MAPPING__
+#define __MSP430_HAS_PMM__
+#define __MSP430_HAS_REF__
+#define __MSP430_HAS_SFR__
+#define __MSP430_HAS_SYS__
+#define __MSP430_HAS_TxA7__
+#define __MSP430_HAS_TxB7__
+#define __MSP430_HAS_UCS__
+#define __MSP430_HAS_USCI_Ax__
+#define __MSP430_HAS_USCI_Bx__
+#define __MSP430_HAS_WDT_A__
+#define __MSP430_HAS_MPY32__
+#define __MSP430_HAS_DMAX_3__
+#define __interrupt
+#define __even_in_range(x, y) (x)
+#define __no_operation()
+#define __enable_interrupt()
+#define __disable_interrupt()
+#define __delay_cycles(x)
+#define __bis_SR_register(x) stub_bis_sr(x)
+#define __bic_SR_register(x)
+#define __bis_SR_register_on_exit(x)
+#define __bic_SR_register_on_exit(x) stub_bic_sr_on_exit(x)
+#define __get_SR_register_on_exit() stub_sr
+#define __get_SR_register() stub_sr
+#define __data16_write_addr(a, v) ((void)(a), (void)(v))
+#define __data16_read_addr(a) ((void)(a), 0UL)
+extern unsigned stub_sr;
+void stub_bis_sr(unsigned bits);
+void stub_bic_sr_on_exit(unsigned bits);
+#define BIT0 0x01
+#define BIT1 0x02
+#define BIT2 0x04
+#define BIT3 0x08
+#define BIT4 0x10
+#define BIT5 0x20
+#define BIT6 0x40
+#define BIT7 0x80
+#define BIT8 0x100
+#define BIT9 0x200
+#define BITA 0x400
+#define BITB 0x800
+#define BITC 0x1000
+#define BITD 0x2000
+#define BITE 0x4000
+#define BITF 0x8000
+#define CPUOFF 0x10
+#define GIE 0x08
+#define LPM0_bits CPUOFF
+#define LPM3_bits 0xD0
+#define WDTPW 0x5A00
+#define WDTHOLD 0x80
+#define R8(n)  extern volatile uint8_t n;
+#define R16(n) extern volatile uint16_t n;
+#include "registers.def"
+#undef R8
+#undef R16
+#define TASSEL_1 0x0100
+#define TASSEL_2 0x0200
+#define TASSEL__ACLK TASSEL_1
+#define TASSEL__SMCLK TASSEL_2
+#define MC_0 0x0000
+#define MC_1 0x0010
+#define MC_2 0x0020
+#define MC_3 0x0030
+#define MC__STOP MC_0
+#define MC__UP MC_1
+#define MC__CONTINUOUS MC_2
+#define MC__CONTINOUS MC_2
+#define TACLR 0x0004
+#define TAIE 0x0002
+#define TAIFG 0x0001
+#define ID_0 0
+#define ID_3 0xC0
+#define TBSSEL_2 0x0200
+#define TBCLR 0x0004
+#define CCIE 0x0010
+#define CCIFG 0x0001
+#define COV 0x0002
+#define OUT 0x0004
+#define CCI 0x0008
+#define CAP 0x0100
+#define SCS 0x0800
+#define CM_0 0x0000
+#define CM_1 0x4000
+#define CM_2 0x8000
+#define CM_3 0xC000
+#define CCIS_0 0x0000
+#define CCIS_1 0x1000
+#define CCIS_2 0x2000
+#define CCIS_3 0x3000
+#define OUTMOD_0 0x0000
+#define OUTMOD_1 0x0020
+#define OUTMOD_2 0x0040
+#define OUTMOD_3 0x0060
+#define OUTMOD_4 0x0080
+#define OUTMOD_5 0x00A0
+#define OUTMOD_6 0x00C0
+#define OUTMOD_7 0x00E0
+#define UCSWRST 0x01
+#define UCSSEL_2 0x80
+#define UCBRF_0 0x00
+#define UCRXIE 0x01
+#define UCTXIE 0x02
+#define UCRXIFG 0x01
+#define UCTXIFG 0x02
+#define UCBUSY 0x01
+#define UCRXERR 0x04
+#define UCOE 0x20
+#define REFMSTR 0x0080
+#define ADC12ON 0x0010
+#define ADC12SC 0x0001
+#define ADC12ENC 0x0002
+#define ADC12MSC 0x0080
+#define ADC12SHT0_0 0x0000
+#define ADC12SHT0_1 0x0100
+#define ADC12SHT0_2 0x0200
+#define ADC12SHT0_4 0x0400
+#define ADC12REFON 0x0020
+#define ADC12REF2_5V 0x0040
+#define ADC12SHP 0x0200
+#define ADC12SHS_0 0x0000
+#define ADC12SHS_1 0x0400
+#define ADC12SHS_2 0x0800
+#define ADC12SHS_3 0x0C00
+#define ADC12CONSEQ_0 0x0000
+#define ADC12CONSEQ_1 0x0002
+#define ADC12CONSEQ_2 0x0004
+#define ADC12CONSEQ_3 0x0006
+#define ADC12CSTARTADD_0 0x0000
+#define ADC12RES_0 0x0000
+#define ADC12RES_1 0x0010
+#define ADC12RES_2 0x0020
+#define ADC12SREF_1 0x10
+#define ADC12INCH_0 0x00
+#define ADC12EOS 0x80
+#define ADC12BUSY 0x0001
+#define ADC12IE0 0x0001
+#define DMADT_0 0x0000
+#define DMADT_1 0x1000
+#define DMADT_2 0x2000
+#define DMADT_4 0x4000
+#define DMADT_5 0x5000
+#define DMADT_6 0x6000
+#define DMADSTINCR_0 0x0000
+#define DMADSTINCR_3 0x0C00
+#define DMASRCINCR_0 0x0000
+#define DMASRCINCR_2 0x0200
+#define DMASRCINCR_3 0x0300
+#define DMADSTBYTE 0x0080
+#define DMASRCBYTE 0x0040
+#define DMALEVEL 0x0020
+#define DMAEN 0x0010
+#define DMAIFG 0x0008
+#define DMAIE 0x0004
+#define DMAABORT 0x0002
+#define DMAREQ 0x0001
+#define DMA0TSEL_1 0x0001
+#define PMAPKEY 0x2D52
+#define PMAPRECFG 0x0002
+#define PM_TB0CCR0A 23
+#define PM_TB0CCR1A 24
+#define PM_TB0CCR2A 25
+#define PM_TA1CCR1A 22
+#define PM_NONE 0
+#define TIMER0_A0_VECTOR 53
+#define TIMER0_A1_VECTOR 52
+#define TIMER1_A0_VECTOR 49
+#define TIMER1_A1_VECTOR 48
+#define TIMER2_A0_VECTOR 44
+#define TIMER2_A1_VECTOR 43
+#define TIMER0_B0_VECTOR 59
+#define TIMER0_B1_VECTOR 58
+#define PORT1_VECTOR 47
+#define PORT2_VECTOR 42
+#define USCI_A1_VECTOR 46
+#define DMA_VECTOR 50
+#define ADC12_VECTOR 54
+#define SELM__DCOCLK 0x0003
+#define DIVM__1 0x0000
+#define PMMCOREV_3 0x0003
+#define CRC_BASE 0x0150
+#define DMA_BASE 0x0500
+#define USCI_A1_BASE 0x0600
+#define TIMER_A0_BASE 0x0340
+#define TIMER_A1_BASE 0x0380
+#define TIMER_A2_BASE 0x0400
+#define TIMER_B0_BASE 0x03C0
+#define ADC12_A_BASE 0x0700
+#define OFS_CRCDI (0x0000u)
+#define OFS_CRCDI_L OFS_CRCDI
+#define CLLD_1 0x0200
+#define TBSSEL__SMCLK 0x0200
+#define USCI_A0_VECTOR 56
+#endif
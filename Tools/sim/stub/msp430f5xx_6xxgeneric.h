@@ -0,0 +1 @@
+// Empty, stub/msp430.h already has everything the driverlib headers need
@@ -0,0 +1,37 @@
+// Registers of stub/msp430.h and the status register hooks
+#include <msp430.h>
+#include "sim.h"
+
+#define R8(n)  volatile uint8_t n;
+#define R16(n) volatile uint16_t n;
+#include "registers.def"
+
+unsigned char uart_sink[1 << 20];      // What the boards sent to the computer
+unsigned int uart_n;
+unsigned stub_sr;
+void (*sim_idle)(void);                // Set by the simulation, runs the hardware until an ISR wakes the CPU
+unsigned int sim_timer_counter = 480;
+
+// __bis_SR_register(LPM0_bits + GIE): the CPU sleeps, the simulation takes over
+void stub_bis_sr(unsigned bits) {
+
+    stub_sr |= bits;
+    if (sim_idle && (bits & CPUOFF)) {
+        sim_idle();
+    }
+    stub_sr &= ~CPUOFF;
+}
+
+// __bic_SR_register_on_exit(LPM0_bits) in an ISR: the CPU resumes main() after RETI
+void stub_bic_sr_on_exit(unsigned bits) {
+
+    stub_sr &= ~bits;
+}
+
+// Flags that the real hardware raises on its own, so the busy waits of the boards return
+__attribute__((constructor)) static void regsInit(void) {
+
+    UCA0IFG = UCTXIFG;
+    UCA1IFG = UCTXIFG;
+    ADC12IFG = BIT0;
+}
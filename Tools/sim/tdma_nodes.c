@@ -0,0 +1,171 @@
+// Several senders on one receiver, each free to send or kept to its TDMA slot.
+//
+// Six builds of the sender with TDMA, node 0 the master, node k in slot k. Their real TA2
+// poll ISRs and UCA0 beacon ISRs run on ACLKs that are each up to 2 % off (REFO), the
+// beacon of the master reaches the others one byte time at TDMA_BAUD_RATE later. A node
+// with data starts its frame on the poll where tdma_turn is set.
+//
+// Without TDMA the nodes send whenever they have data, a random part of a poll after it,
+// and wait 1.5 ms between frames. Frames that overlap on the receiver are lost.
+//
+// The frame is one built by buildPacket() of node 0 with a full buffer, the slot is counted
+// in polls between two beacons of the master, so both follow the #defines of the sender.
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <msp430.h>
+#include "sim.h"
+
+#define NODES         6
+#define DURATION      20e6              // (us)
+#define SYMBOL_US     20.0              // TIMER_COUNTER 480 at 24 MHz
+#define START_US      50.0              // sendPacket() up to the start bit
+#define GAP_US        1500.0            // Without TDMA, between two frames of a node
+#define BEACON_US     (10e6 / 9600)     // Beacon byte on the UCA0 line (TDMA_BAUD_RATE)
+#define BEACON        0xB5              // TDMA_BEACON
+#define MAX_FRAMES    200000
+
+#define NODE(k) \
+    extern int n##k##_main(void); \
+    extern void n##k##_TIMER2_A0_ISR(void); \
+    extern void n##k##_USCI_A0_ISR(void) __attribute__((weak)); /* Not on the master */ \
+    extern volatile char n##k##_tdma_turn; \
+    extern volatile unsigned int n##k##_sending;
+NODE(0) NODE(1) NODE(2) NODE(3) NODE(4) NODE(5)
+extern char n0_storeByte(char byte);
+extern void n0_buildPacket(void);
+extern unsigned int n0_packet_length;
+
+struct node {
+    int (*main)(void);
+    void (*poll)(void);
+    void (*beacon)(void);
+    volatile char *tdma_turn;
+    volatile unsigned int *sending;
+};
+
+#define N(k) {n##k##_main, n##k##_TIMER2_A0_ISR, n##k##_USCI_A0_ISR, &n##k##_tdma_turn, &n##k##_sending}
+static const struct node nodes[NODES] = {N(0), N(1), N(2), N(3), N(4), N(5)};
+
+struct frame {
+    double start, end;
+};
+
+static struct frame frames[MAX_FRAMES];
+static unsigned int frame_count;
+static jmp_buf init_done;
+static double frame_us;                 // Longest frame on the air
+
+static void idleInit(void) {
+
+    longjmp(init_done, 1);
+}
+
+static void run(unsigned int senders, int tdma) {
+
+    double period[NODES], next_poll[NODES], busy_until[NODES];
+    double now = 0, beacon_at = -1, start;
+    unsigned int k, j, good = 0;
+
+    srand(3);
+    frame_count = 0;
+    for (k = 0; k < NODES; k++) {
+        sim_idle = idleInit;
+        if (!setjmp(init_done)) {
+            nodes[k].main();
+        }
+        period[k] = SIM_POLL_CYCLES / SIM_CLOCK * 1e6 * (1 + ((rand() % 401) - 200) / 10000.0);
+        next_poll[k] = rand() % 976;
+        busy_until[k] = 0;
+        *nodes[k].sending = 1;          // Always a frame waiting in sendPacket()
+    }
+    sim_idle = NULL;
+    stub_sr = GIE;
+
+    while (now < DURATION && frame_count < MAX_FRAMES) {
+        k = 0;
+        for (j = 1; j < NODES; j++) {
+            if (next_poll[j] < next_poll[k]) {
+                k = j;
+            }
+        }
+        now = next_poll[k];
+
+        // The beacon ends before this poll: the other nodes restart their superframe
+        if (beacon_at >= 0 && beacon_at <= now) {
+            for (j = 1; j < NODES; j++) {
+                UCA0IV = 2;
+                UCA0RXBUF = BEACON;
+                nodes[j].beacon();
+            }
+            beacon_at = -1;
+        }
+
+        UCA0TXBUF = 0;
+        nodes[k].poll();
+        next_poll[k] = now + period[k];
+        if (k == 0 && UCA0TXBUF == BEACON) {
+            beacon_at = now + BEACON_US;
+        }
+
+        if (k >= senders || now < busy_until[k]) {
+            continue;
+        }
+        if (tdma) {
+            if (*nodes[k].tdma_turn) {
+                start = now + START_US;
+                busy_until[k] = start + frame_us;
+                frames[frame_count++] = (struct frame){start, start + frame_us};
+            }
+        }
+        else {
+            start = now + rand() % 1000;
+            busy_until[k] = start + frame_us + GAP_US;
+            frames[frame_count++] = (struct frame){start, start + frame_us};
+        }
+    }
+
+    // Frames are in start order within a poll or two, no overlap is further than 20 away
+    for (k = 0; k < frame_count; k++) {
+        int hit = 0;
+        for (j = k > 20 ? k - 20 : 0; j < frame_count && j < k + 20; j++) {
+            if (j != k && frames[j].start < frames[k].end && frames[k].start < frames[j].end) {
+                hit = 1;
+            }
+        }
+        good += !hit;
+    }
+    printf("%-5s %8u %12.1f %12.1f %8.0f%%\n", tdma ? "TDMA" : "free", senders, frame_count / (DURATION / 1e6),
+           good / (DURATION / 1e6), frame_count ? 100.0 * good / frame_count : 0);
+}
+
+int main(void) {
+
+    static const unsigned int senders[] = {1, 2, 3, 4, 6};
+    unsigned int s, polls = 0, beacons = 0;
+
+    sim_idle = idleInit;
+    if (!setjmp(init_done)) {
+        n0_main();
+    }
+    sim_idle = NULL;
+    while (!n0_storeByte(0x55));        // A full buffer
+    n0_buildPacket();
+    frame_us = n0_packet_length * SYMBOL_US;
+    while (beacons < 2) {
+        UCA0TXBUF = 0;
+        n0_TIMER2_A0_ISR();
+        polls += beacons == 1;
+        beacons += UCA0TXBUF == BEACON;
+    }
+
+    printf("Senders with a frame always waiting, frames of %u symbols (%.1f polls), %d slots of %u polls, "
+           "%.0f s per line\n\n", n0_packet_length, frame_us / (SIM_POLL_CYCLES / SIM_CLOCK * 1e6), NODES,
+           polls / NODES, DURATION / 1e6);
+    printf("%-5s %8s %12s %12s %9s\n", "", "senders", "frames/s", "received/s", "received");
+    for (s = 0; s < sizeof(senders) / sizeof(senders[0]); s++) {
+        run(senders[s], 0);
+        run(senders[s], 1);
+    }
+    return 0;
+}
@@ -0,0 +1,403 @@
+// Sender transmit engines on a cycle model of Timer_A and the CPU.
+//
+// The real sendPacket() and interrupt routines of the sender run here. The model puts a
+// timestamp on every write to P2.0: TX_SOFTWARE writes P2OUT in the loop woken by the TA0
+// CCR0 tick, TX_TIMER has the TA1.1 compare output set or reset the pin and TX_DMA has DMA0
+// copy packet[] to P2OUT on every TA0 CCR0 compare. The edges are then checked against
+// packet[] on the ideal symbol grid.
+//
+// The CPU costs below are estimates from the MSP430X instruction timings for what the C
+// of each path compiles to, not measurements. The only other interrupt is the UART poll of
+// TA2, which delays the others while it runs (interrupts don't nest).
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <msp430.h>
+#include "sim.h"
+
+#define C_ACCEPT      6                 // Interrupt accepted, PC and SR pushed, vector read
+#define C_RETI        5
+#define C_T0_ISR      15                // TIMER0_A0_ISR: sending and CPUOFF tested, CPUOFF cleared on the stack
+#define C_SW_STORE    14                // TX_SOFTWARE: back in the loop, up to the P2OUT write
+#define C_SW_LOOP     38                // Up to the next LPM0: i++ and i < packet_length on an unsigned long
+#define C_T1_CCR      30                // TIMER1_A1_ISR: TA1IV, tx_pos++, end test, up to the TA1CCR1 write
+#define C_T1_MODE     45                // Up to the TA1CCTL1 write (OUTMOD of the next symbol)
+#define C_T1_LATE     52                // Up to the TA1R read that checks the compare is still ahead
+#define C_T1_ISR      57                // Whole body, with the register pops
+#define C_DMA_WRITE   4                 // TX_DMA: TA0 CCR0 compare to P2OUT written (sync + 2 cycle transfer)
+#define C_DMA_STEAL   2                 // CPU held while DMA0 has the bus
+#define C_DMA_ISR     25                // DMA_ISR: DMAIV, TA0 stopped, sending cleared, CPUOFF cleared on the stack
+#define C_POLL        80                // TIMER2_A0_ISR with nothing to do
+
+#define FRAMES        50
+#define MAX_SYMBOLS   2048
+
+// One build of the sender per engine, TIMER_COUNTER is sim_timer_counter
+#define BOARD(p) \
+    extern int p##_main(void); \
+    extern char p##_storeByte(char byte); \
+    extern void p##_sendPacket(void); \
+    extern char p##_packet[]; \
+    extern unsigned int p##_packet_length; \
+    extern void p##_TIMER0_A0_ISR(void); \
+    extern void p##_TIMER1_A1_ISR(void); \
+    extern void p##_DMA_ISR(void);
+BOARD(sw)
+BOARD(tmr)
+BOARD(dma)
+extern volatile char tmr_tx_late;
+extern unsigned int tmr_tx_late_frames;
+
+struct engine {
+    const char *name;
+    int (*main)(void);
+    char (*storeByte)(char byte);
+    void (*sendPacket)(void);
+    char *packet;
+    unsigned int *packet_length;
+    char p2out_image;                   // packet[] holds P2OUT bytes instead of bits
+};
+
+static const struct engine engines[] = {
+    {"TX_SOFTWARE", sw_main, sw_storeByte, sw_sendPacket, sw_packet, &sw_packet_length, 0},
+    {"TX_TIMER",    tmr_main, tmr_storeByte, tmr_sendPacket, tmr_packet, &tmr_packet_length, 0},
+    {"TX_DMA",      dma_main, dma_storeByte, dma_sendPacket, dma_packet, &dma_packet_length, 1},
+};
+
+static jmp_buf init_done;
+static double now;                      // SMCLK cycles
+static double busy_until;               // End of the ISR that is running
+static double next_poll;
+static double period;
+
+// Symbol writes of the frame on the air
+static double write_time[MAX_SYMBOLS];
+static char write_level[MAX_SYMBOLS];
+static unsigned int writes;
+
+// Per engine and rate
+static unsigned long wakeups;
+static double cpu_cycles;
+static unsigned long late;              // TX_TIMER frames cut short by a late TA1CCR1, sent again
+
+static void record(double time, char level) {
+
+    if (writes < MAX_SYMBOLS) {
+        write_time[writes] = time;
+        write_level[writes] = level;
+        writes++;
+    }
+}
+
+// An interrupt raised at t runs once the CPU is free, the UART polls in between go first
+static double isrStart(double t) {
+
+    while (next_poll <= t || next_poll < busy_until) {
+        double start = next_poll > busy_until ? next_poll : busy_until;
+        busy_until = start + C_ACCEPT + C_POLL + C_RETI;
+        cpu_cycles += C_ACCEPT + C_POLL + C_RETI;
+        next_poll += SIM_POLL_CYCLES;
+    }
+    return (t > busy_until ? t : busy_until) + C_ACCEPT;
+}
+
+static void idleInit(void) {
+
+    longjmp(init_done, 1);              // main() is set up and waits for data
+}
+
+// ----------- TX_SOFTWARE ----------------------------------
+static double next_tick;                // Next TA0 CCR0 compare
+static double wake_time;
+static int loop_entries;
+
+// The TA0 CCR0 interrupt raised at next_tick
+static void tick(void) {
+
+    double start = isrStart(next_tick);
+    sw_TIMER0_A0_ISR();
+    busy_until = start + C_T0_ISR + C_RETI;
+    cpu_cycles += C_ACCEPT + C_T0_ISR + C_RETI;
+    next_tick += period;
+    wakeups++;
+}
+
+// Called from the loop of sendPacket(), once before every P2OUT write
+static void idleSoftware(void) {
+
+    double sleep_time = now;
+
+    if (loop_entries++ > 0) {
+        record(wake_time + C_SW_STORE, !(P2OUT & BIT0));          // LED is on when P2.0 is low
+        sleep_time = wake_time + C_SW_LOOP;
+        cpu_cycles += C_SW_LOOP;
+    }
+
+    // A tick while the loop runs finds the CPU on, its wakeup is lost and the loop waits for its ISR
+    while (next_tick < sleep_time) {
+        unsigned sr = stub_sr;
+        double before = busy_until > next_tick ? busy_until : next_tick;
+        stub_sr = GIE;
+        tick();
+        stub_sr = sr;
+        sleep_time += busy_until - before;
+    }
+
+    while (stub_sr & CPUOFF) {
+        tick();
+    }
+    wake_time = busy_until;
+}
+
+// ----------- TX_TIMER -------------------------------------
+static double ccr_write;                // When TA1CCR1 got its value
+static double mode_write;               // When TA1CCTL1 got its value
+static uint16_t old_mode;               // TA1CCTL1 before that
+static int aborted;                     // The last ISR cut the frame short, sendPacket() starts it again
+
+// First time TA1R counts to TA1CCR1 after it was written (continuous mode, TA1R counts SMCLK)
+static double nextCompare(void) {
+
+    double ahead = (double)TA1CCR1 - fmod(ccr_write, 65536);
+    if (ahead <= 0) {
+        ahead += 65536;                 // Already passed, the next match is a whole turn later
+    }
+    return ccr_write + ahead;
+}
+
+static char outputLevel(uint16_t control, char level) {
+
+    switch (control & OUTMOD_7) {
+    case OUTMOD_0: return !(control & OUT);
+    case OUTMOD_1: return 0;            // Set: P2.0 high, LED off
+    case OUTMOD_5: return 1;            // Reset: P2.0 low, LED on
+    default:       return level;
+    }
+}
+
+static void idleTimer(void) {
+
+    static char level;
+
+    if (aborted) {
+        aborted = 0;
+        writes = 0;                     // Only the last try of the frame is checked
+    }
+    while (stub_sr & CPUOFF) {
+        double compare = nextCompare();
+        double start;
+
+        // The mode written by the last ISR only counts if it came before this compare
+        level = outputLevel(compare >= mode_write ? TA1CCTL1 : old_mode, level);
+        record(compare, level);
+
+        start = isrStart(compare);
+        ccr_write = start + C_T1_CCR;
+        mode_write = start + C_T1_MODE;
+        old_mode = TA1CCTL1;
+        TA1IV = 2;
+        TA1R = (uint16_t)fmod(start + C_T1_LATE, 65536);
+        tmr_TIMER1_A1_ISR();
+        busy_until = start + C_T1_ISR + C_RETI;
+        cpu_cycles += C_ACCEPT + C_T1_ISR + C_RETI;
+        wakeups++;
+        if (tmr_tx_late) {
+            late++;
+            aborted = 1;
+            mode_write = start + C_T1_ISR;      // OUTMOD_0 written at the end of the ISR
+            ccr_write = busy_until;             // startTimerTransmit() of the next try
+            TA1R = (uint16_t)fmod(busy_until, 65536);
+        }
+    }
+    level = outputLevel(TA1CCTL1, level);
+    record(mode_write, level);          // Idle level after the stop bit
+}
+
+// ----------- TX_DMA ---------------------------------------
+static double dma_start;                // TA0 started by startDmaTransmit()
+
+// DMA0 runs on every compare whatever the CPU does, the CPU only waits for its interrupt
+static void idleDma(void) {
+
+    unsigned long transfer = 0;
+
+    while (stub_sr & CPUOFF) {
+        double write = dma_start + (++transfer) * period + C_DMA_WRITE;
+        double start;
+
+        cpu_cycles += C_DMA_STEAL;
+        if (!sim_dmaTransfer(0)) {
+            record(write, !(P2OUT & BIT0));
+            continue;
+        }
+        record(write, !(P2OUT & BIT0));
+
+        start = isrStart(write);
+        DMAIV = 2;
+        dma_DMA_ISR();
+        busy_until = start + C_DMA_ISR + C_RETI;
+        cpu_cycles += C_ACCEPT + C_DMA_ISR + C_RETI;
+        wakeups++;
+    }
+}
+
+// ----------- frames ---------------------------------------
+struct result {
+    double min_offset, max_offset;      // Symbol writes against the grid
+    unsigned long wrong;                // Symbols with another level than packet[] in their middle
+    unsigned long symbols;
+    double frame_cycles;
+};
+
+// Symbol k must be on the air from t0 + k * period, t0 the earliest of the frame
+static void checkFrame(const struct engine *engine, struct result *result) {
+
+    unsigned int k, w;
+    unsigned int symbols = *engine->packet_length;
+    double t0 = 1e300, lo = 1e300, hi = -1e300;
+
+    for (k = 0; k < symbols && k < writes; k++) {
+        if (write_time[k] - k * period < t0) {
+            t0 = write_time[k] - k * period;
+        }
+    }
+    for (k = 0; k < symbols && k < writes; k++) {
+        double offset = write_time[k] - k * period - t0;
+        lo = offset < lo ? offset : lo;
+        hi = offset > hi ? offset : hi;
+    }
+    result->min_offset = lo < result->min_offset ? lo : result->min_offset;
+    result->max_offset = hi > result->max_offset ? hi : result->max_offset;
+
+    for (k = 0; k < symbols; k++) {
+        double middle = t0 + (k + 0.5) * period;
+        char level = 0;
+        for (w = 0; w < writes && write_time[w] <= middle; w++) {
+            level = write_level[w];
+        }
+        if (level != (engine->p2out_image ? !(engine->packet[k] & BIT0) : engine->packet[k] != 0)) {
+            result->wrong++;
+        }
+    }
+    result->symbols += symbols;
+}
+
+static void run(const struct engine *engine, unsigned int timer_counter, struct result *result) {
+
+    unsigned int frame;
+
+    sim_timer_counter = timer_counter;
+    period = timer_counter;             // NRZ at LINK_RATE 0, one symbol per TIMER_COUNTER
+    memset(result, 0, sizeof(*result));
+    result->min_offset = 1e300;
+    result->max_offset = -1e300;
+    wakeups = 0;
+    cpu_cycles = 0;
+    late = 0;
+    aborted = 0;
+    now = 0;
+    busy_until = 0;
+    next_poll = SIM_POLL_CYCLES / 3;
+    next_tick = period;
+
+    sim_idle = idleInit;
+    if (!setjmp(init_done)) {
+        engine->main();
+    }
+    stub_sr = GIE;
+
+    srand(timer_counter);
+    if (engine->sendPacket == sw_sendPacket && C_ACCEPT + C_T0_ISR + C_RETI >= period) {
+        result->wrong = ~0UL;           // Back to back TA0 ISRs, main() never runs again
+        return;
+    }
+    for (frame = 0; frame < FRAMES; frame++) {
+        double frame_start;
+
+        while (!engine->storeByte((char)rand()));
+
+        // Only what happens during the frame is counted
+        now += 50 * period + (rand() % timer_counter);
+        while (next_poll < now) {
+            next_poll += SIM_POLL_CYCLES;
+        }
+        while (next_tick < now) {
+            next_tick += period;
+        }
+        busy_until = now;
+        frame_start = now;
+        writes = 0;
+
+        if (engine->sendPacket == sw_sendPacket) {
+            loop_entries = 0;
+            sim_idle = idleSoftware;
+            engine->sendPacket();
+            record(wake_time + C_SW_STORE, !(P2OUT & BIT0));       // Last symbol, the loop has ended
+            now = wake_time + C_SW_LOOP;
+        }
+        else if (engine->sendPacket == dma_sendPacket) {
+            dma_start = now;
+            sim_idle = idleDma;
+            engine->sendPacket();
+            now = busy_until;
+        }
+        else {
+            ccr_write = now;
+            mode_write = now;
+            TA1R = (uint16_t)fmod(now, 65536);
+            sim_idle = idleTimer;
+            engine->sendPacket();
+            now = busy_until;
+        }
+        result->frame_cycles += now - frame_start;
+        checkFrame(engine, result);
+    }
+}
+
+int main(void) {
+
+    static const unsigned int rates[] = {480, 240, 160, 120, 96, 80, 64, 48, 32, 24};
+    unsigned int r, e, lost;
+    unsigned int fastest[sizeof(engines) / sizeof(engines[0])] = {0};
+    struct result result;
+
+    printf("Sender symbol writes against the ideal grid, %d frames of random bytes per line\n", FRAMES);
+    printf("offset: write time - symbol start, wrong: symbols with the wrong level in their middle,\n"
+           "late: tries cut short by a late TA1CCR1 and sent again, lost: frames given up after TX_RETRIES\n\n");
+    printf("%-12s %8s %8s %18s %8s %6s %6s %10s %6s\n", "engine", "TIMER_", "kbit/s", "offset", "wrong", "late",
+           "lost", "ISRs", "CPU");
+    printf("%-12s %8s %8s %18s %8s %6s %6s %10s %6s\n", "", "COUNTER", "", "(cycles)", "symbols", "", "", "/frame",
+           "busy");
+    for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        for (e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+            lost = tmr_tx_late_frames;
+            run(&engines[e], rates[r], &result);
+            lost = tmr_tx_late_frames - lost;
+            if (result.wrong == ~0UL) {
+                printf("%-12s %8u %8.1f  the TA0 ISR takes longer than a symbol\n", engines[e].name, rates[r],
+                       SIM_CLOCK / 1000.0 / rates[r]);
+                continue;
+            }
+            printf("%-12s %8u %8.1f %7.0f..%-9.0f %8lu %6lu %6u %10.1f %5.1f%%\n", engines[e].name, rates[r],
+                   SIM_CLOCK / 1000.0 / rates[r], result.min_offset, result.max_offset, result.wrong, late, lost,
+                   (double)wakeups / FRAMES, 100.0 * cpu_cycles / result.frame_cycles);
+            if (result.wrong == 0 && lost == 0 && fastest[e] == r) {
+                fastest[e] = r + 1;
+            }
+        }
+    }
+
+    printf("\nFastest rate without a wrong symbol or a lost frame:\n");
+    for (e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+        if (fastest[e] == 0) {
+            printf("%-12s none\n", engines[e].name);
+        }
+        else {
+            printf("%-12s TIMER_COUNTER %u, %.1f kbit/s\n", engines[e].name, rates[fastest[e] - 1],
+                   SIM_CLOCK / 1000.0 / rates[fastest[e] - 1]);
+        }
+    }
+    return 0;
+}
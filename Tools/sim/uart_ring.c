@@ -0,0 +1,96 @@
+// Bytes from the computer through DMA1 and uart_ring into the frames of the sender.
+//
+// The computer sends a little slower than the frames carry, DMA1 moves every byte to the
+// ring and the real TIMER2_A0_ISR and readUartRing() run once per TA2 poll. A frame is on the
+// air for FRAME_POLLS, and waits some more polls before it goes (CSMA back-off, TDMA slot,
+// ARQ acks): as long as both buffers are full the ring isn't read and DMA1 goes round.
+//
+// Bytes of the computer are n % 251 in turn, so every break in the bytes of the frames is
+// a place where bytes were dropped. Each one must come from an overrun counted in
+// uart_overruns (several overruns while the buffers stay full make one break), and the
+// bytes between two breaks must come in order.
+#include <setjmp.h>
+#include <stdio.h>
+#include <msp430.h>
+#include "sim.h"
+
+#define BYTES_PER_POLL  4               // A frame carries 32 bytes in FRAME_POLLS
+#define FRAME_POLLS     6               // Frame of 32 bytes on the air
+#define POLLS           20000
+#define FRAME_BYTES     33              // HEADER_SIZE + BUFFER_SIZE
+
+extern int ur_main(void);
+extern void ur_TIMER2_A0_ISR(void);
+extern void ur_readUartRing(void);
+extern char ur_buffer[][FRAME_BYTES];
+extern volatile unsigned int ur_send_index, ur_frames_ready;
+extern unsigned int ur_uart_overruns;
+
+static jmp_buf init_done;
+
+static void idleInit(void) {
+
+    longjmp(init_done, 1);
+}
+
+static int run(unsigned int wait_polls) {
+
+    unsigned long fed = 0, through = 0, breaks = 0;
+    unsigned int poll, b, on_air = 0, length;
+    int last = -1;
+    unsigned char byte;
+
+    sim_idle = idleInit;
+    if (!setjmp(init_done)) {
+        ur_main();
+    }
+    sim_idle = NULL;
+    stub_sr = GIE;
+
+    for (poll = 0; poll < POLLS; poll++) {
+        for (b = 0; b < BYTES_PER_POLL; b++) {
+            UCA1RXBUF = fed++ % 251;
+            sim_dmaTransfer(1);
+        }
+        DMA1SZ = sim_dma[1].left;
+        ur_TIMER2_A0_ISR();
+        ur_readUartRing();
+
+        // The frame in front goes once it waited and was on the air
+        if (ur_frames_ready == 0) {
+            continue;
+        }
+        if (++on_air < wait_polls + FRAME_POLLS) {
+            continue;
+        }
+        on_air = 0;
+        length = (unsigned char)ur_buffer[ur_send_index][0];
+        for (b = 0; b < length; b++) {
+            byte = ur_buffer[ur_send_index][1 + b];
+            breaks += last >= 0 && byte != (last + 1) % 251;
+            last = byte;
+        }
+        through += length;
+        ur_send_index = (ur_send_index + 1) % 2;
+        ur_frames_ready--;
+    }
+
+    printf("%10u %10lu %10lu %10u %10lu   %s\n", wait_polls, fed, through, ur_uart_overruns, breaks,
+           breaks <= ur_uart_overruns ? "ok" : "WRONG: bytes lost or mixed up without an overrun");
+    return breaks > ur_uart_overruns;
+}
+
+int main(void) {
+
+    static const unsigned int waits[] = {0, 2, 4, 8, 16, 32, 64};
+    unsigned int w;
+    int failed = 0;
+
+    printf("Computer sending %d bytes per poll, frames of %d polls, %d polls per line\n\n",
+           BYTES_PER_POLL, FRAME_POLLS, POLLS);
+    printf("%10s %10s %10s %10s %10s\n", "wait", "sent", "in frames", "overruns", "breaks");
+    for (w = 0; w < sizeof(waits) / sizeof(waits[0]); w++) {
+        failed |= run(waits[w]);
+    }
+    return failed;
+}